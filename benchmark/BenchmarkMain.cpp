@@ -1,12 +1,179 @@
 #include <iostream>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <benchmark/benchmark.h>
 
 #include <glog/logging.h>
 #include "ChessEngineLib/Game.hpp"
+#include "ChessEngineLib/GameEngine.hpp"
+#include "ChessEngineLib/MoveList.hpp"
+#include "ChessEngineLib/Perft.hpp"
 #include "ChessEngineLib/RandomMovePlayer.hpp"
 
 using namespace ChessEngineLib;
 
+// Count every heap allocation made by the process so benchmarks can report allocations per iteration
+static std::atomic<std::size_t> allocation_count {0};
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// gcc cannot tell that the replaced operator new above allocates with malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static std::vector<Board> movegen_benchmark_boards() {
+    return {
+        Board::startingPosBoard(),
+        Board::fromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1").value(),
+        Board::fromFen("rn1qk2r/5ppp/4pn2/pPpp1b2/1b1P1B2/4PN1P/PP2KPP1/RN1Q1B1R w kq a6 0 9").value(),
+        Board::fromFen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1").value(),
+    };
+}
+
+static void report_allocations(benchmark::State& state, std::size_t allocations, std::size_t positions_per_iteration) {
+    state.counters["allocs_per_position"] = static_cast<double>(allocations) /
+        static_cast<double>(state.iterations() * positions_per_iteration);
+    state.SetItemsProcessed(state.iterations() * positions_per_iteration);
+}
+
+static void BM_GenerateLegalMovesIntoMoveList(benchmark::State& state) {
+    std::vector<Board> const boards = movegen_benchmark_boards();
+    std::size_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        for (Board const& board: boards) {
+            MoveList moves;
+            generateLegalMoves(board, moves);
+            benchmark::DoNotOptimize(moves.size());
+        }
+    }
+    report_allocations(state, allocation_count.load() - allocations_before, boards.size());
+}
+
+static void BM_GetAllLegalMovesAsUnorderedSet(benchmark::State& state) {
+    std::vector<Board> const boards = movegen_benchmark_boards();
+    std::size_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        for (Board const& board: boards) {
+            std::unordered_set<Move> moves = getAllLegalMoves(board);
+            benchmark::DoNotOptimize(moves.size());
+        }
+    }
+    report_allocations(state, allocation_count.load() - allocations_before, boards.size());
+}
+
+// standard perft reference positions, state.range(0) picks the position and state.range(1) the depth
+static std::vector<std::string> const perft_benchmark_fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+static void BM_Perft(benchmark::State& state) {
+    Board const board = Board::fromFen(perft_benchmark_fens.at(static_cast<std::size_t>(state.range(0)))).value();
+    std::size_t const depth = static_cast<std::size_t>(state.range(1));
+    std::uint64_t nodes = 0;
+    for (auto _ : state) {
+        nodes += perft(board, depth);
+    }
+    state.counters["nodes_per_second"] = benchmark::Counter(static_cast<double>(nodes), benchmark::Counter::kIsRate);
+}
+
+static void BM_ParseFen(benchmark::State& state) {
+    std::vector<std::string_view> const fens(perft_benchmark_fens.begin(), perft_benchmark_fens.end());
+    std::size_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        for (std::string_view fen: fens) {
+            std::optional<Board> board = Board::fromFen(fen);
+            benchmark::DoNotOptimize(board);
+        }
+    }
+    report_allocations(state, allocation_count.load() - allocations_before, fens.size());
+}
+
+static void BM_WriteFen(benchmark::State& state) {
+    std::vector<Board> boards;
+    for (std::string const& fen: perft_benchmark_fens) {
+        boards.push_back(Board::fromFen(fen).value());
+    }
+    std::array<char, Board::maxFenLength> buffer;
+    std::size_t allocations_before = allocation_count.load();
+    for (auto _ : state) {
+        for (Board const& board: boards) {
+            char* end = board.writeFen(buffer.data(), buffer.data() + buffer.size());
+            benchmark::DoNotOptimize(end);
+            benchmark::ClobberMemory();
+        }
+    }
+    report_allocations(state, allocation_count.load() - allocations_before, boards.size());
+}
+
+static std::string const benchmark_pgn = R"raw(
+[Event "F/S Return Match"]
+[Result "1/2-1/2"]
+
+1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6 8. c3 O-O 9. h3 Nb8 10. d4 Nbd7
+11. c4 c6 12. cxb5 axb5 13. Nc3 Bb7 14. Bg5 b4 15. Nb1 h6 16. Bh4 c5 17. dxe5 Nxe4 18. Bxe7 Qxe7
+19. exd6 Qf6 20. Nbd2 Nxd6 21. Nc4 Nxc4 22. Bxc4 Nb6 23. Ne5 Rae8 24. Bxf7+ Rxf7 25. Nxf7 Rxe1+
+26. Qxe1 Kxf7 27. Qe3 Qg5 28. Qxg5 hxg5 29. b3 Ke6 30. a3 Kd6 31. axb4 cxb4 32. Ra5 Nd5 33. f3 Bc8
+34. Kf2 Bf5 35. Ra7 g6 36. Ra6+ Kc5 37. Ke1 Nf4 38. g3 Nxh3 39. Kd2 Kb5 40. Rd6 Kc5 41. Ra6 Nf2
+42. g4 Bd3 43. Re6 1/2-1/2
+)raw";
+
+static void BM_GameFromPgn(benchmark::State& state) {
+    for (auto _ : state) {
+        std::optional<Game> game = Game::fromPgn(benchmark_pgn);
+        benchmark::DoNotOptimize(game);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// plays the moves of benchmark_pgn through Game::makeMove, state.range(0) is 1 to also write the pgn back out
+static void BM_GameMakeMoves(benchmark::State& state) {
+    Game parsed = Game::fromPgn(benchmark_pgn).value();
+    std::vector<Move> moves;
+    for (std::size_t i = 1; i <= parsed.movesSize(); i++) {
+        moves.push_back(parsed.moveAt(i).value().move);
+    }
+    for (auto _ : state) {
+        Game game {};
+        for (Move const& move: moves) {
+            game.makeMove(move);
+        }
+        if (state.range(0) != 0) {
+            std::string pgn = game.toPgn(false);
+            benchmark::DoNotOptimize(pgn);
+        }
+        benchmark::DoNotOptimize(game);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(moves.size()));
+}
+
 static void BM_PlayingGameUsingRandomMovePlayer(benchmark::State& state) {
     RandomMovePlayer rmp = RandomMovePlayer();
     Game game {};
@@ -22,13 +189,22 @@ static void BM_PlayingGameUsingRandomMovePlayer(benchmark::State& state) {
             continue;
         }
         // VLOG(1) << "Making move#" << game.movesSize() + 1;
-        game.makeMove(move_opt.value());
+        game.makeLegalMove(move_opt.value());
         // VLOG(1) << "Finished making move#" << game.movesSize() + 1;
     }
 }
 
 // Register the function as a benchmark
 BENCHMARK(BM_PlayingGameUsingRandomMovePlayer);
+BENCHMARK(BM_GenerateLegalMovesIntoMoveList);
+BENCHMARK(BM_GetAllLegalMovesAsUnorderedSet);
+BENCHMARK(BM_GameFromPgn);
+BENCHMARK(BM_GameMakeMoves)->ArgName("pgn")->Arg(0)->Arg(1);
+BENCHMARK(BM_ParseFen);
+BENCHMARK(BM_WriteFen);
+BENCHMARK(BM_Perft)->ArgNames({"position", "depth"})
+    ->Args({0, 4})->Args({1, 3})->Args({2, 5})->Args({3, 4})->Args({4, 3})->Args({5, 3})
+    ->Unit(benchmark::kMillisecond);
 
 int main(int argc, char** argv) {
     // INFO=0, WARNING=1, ERROR=2, and FATAL=3
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "ChessEngineLib/Board.hpp"
+#include "ChessEngineLib/Move.hpp"
+#include "ChessEngineLib/Perft.hpp"
+
+using namespace ChessEngineLib;
+
+namespace {
+
+void print_square(std::ostream& os, Square s) {
+    os << static_cast<char>('a' + s.col) << static_cast<char>('1' + s.row);
+}
+
+// same notation as the divide output of other engines so the two can be diffed
+void print_move(std::ostream& os, Move const& move) {
+    print_square(os, move.fromSquare);
+    print_square(os, move.toSquare);
+    if (move.promotionTo.has_value()) {
+        os << Piece(move.promotionTo.value(), Color::Black).fen_symbol();
+    }
+}
+
+int usage(char const* program) {
+    std::cerr << "usage: " << program << " <depth> [fen] [--stats] [--threads <n>]" << std::endl;
+    std::cerr << "  --threads <n>  split the root moves between n threads sharing a hash table, 0 for one per core" << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    char* end = nullptr;
+    long depth = std::strtol(argv[1], &end, 10);
+    if (*end != '\0' || depth < 1) {
+        return usage(argv[0]);
+    }
+    std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    bool with_stats = false;
+    std::optional<std::size_t> threads = std::nullopt;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") {
+            with_stats = true;
+        } else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                return usage(argv[0]);
+            }
+            long n = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || n < 0) {
+                return usage(argv[0]);
+            }
+            threads = static_cast<std::size_t>(n);
+        } else {
+            fen = arg;
+        }
+    }
+    std::optional<Board> board = Board::fromFen(fen);
+    if (!board.has_value()) {
+        std::cerr << "invalid fen: " << fen << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t total = 0;
+    auto divided = threads.has_value() ?
+        perftDivideParallel(board.value(), static_cast<std::size_t>(depth), threads.value()) :
+        perftDivide(board.value(), static_cast<std::size_t>(depth));
+    for (auto const& [move, nodes]: divided) {
+        print_move(std::cout, move);
+        std::cout << ": " << nodes << "\n";
+        total += nodes;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "\nNodes searched: " << total << "\n";
+    std::cout << "Time: " << elapsed.count() << "s";
+    if (elapsed.count() > 0) {
+        std::cout << ", " << static_cast<std::uint64_t>(static_cast<double>(total) / elapsed.count()) << " nodes/s";
+    }
+    std::cout << std::endl;
+
+    if (with_stats) {
+        std::cout << perftDetailed(board.value(), static_cast<std::size_t>(depth)) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "Attacks.hpp"
+#include "Bitboard.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+#if CHESS_ENGINE_PEXT_AVAILABLE
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using ChessEngineLib::Bitboard;
+using ChessEngineLib::SlidingAttackEntry;
+using Direction = std::pair<std::int8_t, std::int8_t>;
+
+constexpr std::array<Direction, 4> rook_directions {{{-1,0}, {0,-1}, {0,1}, {1,0}}};
+constexpr std::array<Direction, 4> bishop_directions {{{-1,-1}, {-1,1}, {1,-1}, {1,1}}};
+
+// Found offline by random search so that no two occupancies with different attack sets collide
+constexpr std::array<Bitboard, 64> rook_magics {
+    0x1080004008801020ULL, 0x0840092002c03000ULL, 0x1900200010400900ULL, 0x0880100008000480ULL,
+    0x4200100420080200ULL, 0x8100020100080400ULL, 0x0200040110886200ULL, 0x0200008040220411ULL,
+    0x0404800084400220ULL, 0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000a001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL, 0x0442000102105084ULL,
+    0x9080010020804100ULL, 0x0040404000201009ULL, 0x0000808010002009ULL, 0x2200090021d00100ULL,
+    0x0008008008040080ULL, 0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000a0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL, 0x1000100080080080ULL,
+    0x0442000a00049020ULL, 0x2100040080020080ULL, 0x0800120400900148ULL, 0x0010040a00128541ULL,
+    0x2800804000800030ULL, 0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xc100020080800400ULL, 0x0002000802000401ULL, 0x0182085882000401ULL,
+    0x0220204000808000ULL, 0x2860100040024022ULL, 0x0001002004110040ULL, 0x99101042000a0020ULL,
+    0x0004080004008080ULL, 0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040a00300ULL, 0x0801100280080480ULL,
+    0x0242009008200600ULL, 0x1002000489500200ULL, 0x0040800200010080ULL, 0x0091800041000080ULL,
+    0x0000209300488001ULL, 0x04c1002414824001ULL, 0x020020000b001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084c0007ULL, 0x0888221800813004ULL, 0x4000002840840112ULL,
+};
+
+constexpr std::array<Bitboard, 64> bishop_magics {
+    0xa010041108003100ULL, 0x006082020a002900ULL, 0x6810010619200000ULL, 0x08281a0520000408ULL,
+    0x0001104001000400ULL, 0x0018901008048400ULL, 0x00040a0210245280ULL, 0x000200210808a402ULL,
+    0x9140048410821200ULL, 0x0800091010820041ULL, 0x20504804832202c0ULL, 0x0100091401081000ULL,
+    0x8021011140000012ULL, 0x0810020804450400ULL, 0x208b0542109008a2ULL, 0x0080084a08040204ULL,
+    0x0040e2a80811244cULL, 0x2505022008008108ULL, 0x0430220100420040ULL, 0x010a040420220040ULL,
+    0x1105000290400000ULL, 0x0093001200822120ULL, 0x4000a62048043004ULL, 0x280120048a015004ULL,
+    0x006090002a020814ULL, 0x44042000240800d0ULL, 0x01102800040a4400ULL, 0x1004080080220040ULL,
+    0x0001001011004024ULL, 0x0010044000805040ULL, 0x0914041200820100ULL, 0x0004821012821480ULL,
+    0x0024040500c05021ULL, 0x0088611002080200ULL, 0x0116080a00040020ULL, 0x4000020080080080ULL,
+    0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL, 0x8081110600002e00ULL,
+    0x2842101105000801ULL, 0x1100809008001025ULL, 0x00020202221c0400ULL, 0x0422014022009020ULL,
+    0x0210046102100c00ULL, 0xc004008082029102ULL, 0x00aa461801101200ULL, 0x0404080080201108ULL,
+    0x020542108c205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL, 0x0400200042021100ULL,
+    0x00004204850400c0ULL, 0x0200100410a42102ULL, 0x1040020801210102ULL, 0x0805040410420000ULL,
+    0x2884804130100200ULL, 0x800c262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+    0x0104000012a02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL, 0x0402020801010201ULL,
+};
+
+// 4096 * 4 corners + 2048 * 24 edges + 1024 * 36 inner squares
+constexpr std::size_t rook_table_size = 102400;
+// sum over all squares of 2^(relevant bits)
+constexpr std::size_t bishop_table_size = 5248;
+
+Bitboard rook_table[rook_table_size];
+Bitboard bishop_table[bishop_table_size];
+
+bool cpu_has_fast_pext() {
+#if CHESS_ENGINE_PEXT_AVAILABLE
+    __builtin_cpu_init();
+    // Zen 1 and Zen 2 implement PEXT in microcode, which is slower than the magic multiply
+    return __builtin_cpu_supports("bmi2") &&
+        !__builtin_cpu_is("znver1") &&
+        !__builtin_cpu_is("znver2");
+#else
+    return false;
+#endif
+}
+
+// Walks each ray one square at a time, only used to fill the tables
+template <std::size_t N>
+Bitboard slow_sliding_attacks(std::uint8_t square, Bitboard occupancy, std::array<Direction, N> const& directions) {
+    Bitboard attacks = 0;
+    for (auto const& direction: directions) {
+        for (
+            std::uint8_t col = square % 8 + direction.first, row = square / 8 + direction.second;
+            (col <= 7) && (row <= 7);
+            col += direction.first, row += direction.second
+        ) {
+            attacks |= ChessEngineLib::squareBit(static_cast<std::uint8_t>(row * 8 + col));
+            if (occupancy & ChessEngineLib::squareBit(static_cast<std::uint8_t>(row * 8 + col))) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+// Squares whose occupancy matters for the attack set, the last square of each ray never does
+template <std::size_t N>
+Bitboard relevant_occupancy_mask(std::uint8_t square, std::array<Direction, N> const& directions) {
+    Bitboard mask = 0;
+    for (auto const& direction: directions) {
+        for (
+            std::uint8_t col = square % 8 + direction.first, row = square / 8 + direction.second;
+            (static_cast<std::uint8_t>(col + direction.first) <= 7) && (static_cast<std::uint8_t>(row + direction.second) <= 7);
+            col += direction.first, row += direction.second
+        ) {
+            mask |= ChessEngineLib::squareBit(static_cast<std::uint8_t>(row * 8 + col));
+        }
+    }
+    return mask;
+}
+
+#if CHESS_ENGINE_PEXT_AVAILABLE
+__attribute__((target("bmi2")))
+std::size_t pext_index(Bitboard occupancy, Bitboard mask) {
+    return _pext_u64(occupancy, mask);
+}
+#endif
+
+std::size_t table_index(SlidingAttackEntry const& entry, Bitboard occupancy, [[maybe_unused]] bool use_pext) {
+#if CHESS_ENGINE_PEXT_AVAILABLE
+    if (use_pext) {
+        return pext_index(occupancy, entry.mask);
+    }
+#endif
+    return ((occupancy & entry.mask) * entry.magic) >> entry.shift;
+}
+
+template <std::size_t N>
+void init_sliding_attacks(
+    SlidingAttackEntry (&entries)[64], Bitboard* table, [[maybe_unused]] std::size_t table_size,
+    std::array<Bitboard, 64> const& magics, std::array<Direction, N> const& directions, bool use_pext
+) {
+    std::size_t offset = 0;
+    for (std::uint8_t square = 0; square < 64; square++) {
+        SlidingAttackEntry& entry = entries[square];
+        entry.mask = relevant_occupancy_mask(square, directions);
+        entry.magic = magics[square];
+        entry.shift = static_cast<std::uint8_t>(64 - ChessEngineLib::popCount(entry.mask));
+        entry.attacks = table + offset;
+        // enumerate every subset of the mask with the carry-rippler trick
+        Bitboard occupancy = 0;
+        do {
+            std::size_t index = table_index(entry, occupancy, use_pext);
+            Bitboard attacks = slow_sliding_attacks(square, occupancy, directions);
+            assert(offset + index < table_size);
+            assert(table[offset + index] == 0 || table[offset + index] == attacks);
+            table[offset + index] = attacks;
+            occupancy = (occupancy - entry.mask) & entry.mask;
+        } while (occupancy);
+        offset += std::size_t {1} << ChessEngineLib::popCount(entry.mask);
+    }
+    assert(offset == table_size);
+}
+
+bool init_all_sliding_attacks() {
+    bool use_pext = cpu_has_fast_pext();
+    init_sliding_attacks(ChessEngineLib::rookAttackEntries, rook_table, rook_table_size, rook_magics, rook_directions, use_pext);
+    init_sliding_attacks(ChessEngineLib::bishopAttackEntries, bishop_table, bishop_table_size, bishop_magics, bishop_directions, use_pext);
+    return use_pext;
+}
+
+}
+
+namespace ChessEngineLib {
+
+SlidingAttackEntry rookAttackEntries[64];
+SlidingAttackEntry bishopAttackEntries[64];
+bool const slidingAttacksUsePext = init_all_sliding_attacks();
+
+#if CHESS_ENGINE_PEXT_AVAILABLE
+__attribute__((target("bmi2")))
+Bitboard pextAttackLookup(SlidingAttackEntry const& entry, Bitboard occupancy) {
+    return entry.attacks[pext_index(occupancy, entry.mask)];
+}
+#endif
+
+}
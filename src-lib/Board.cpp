@@ -1,43 +1,49 @@
 #include "Board.hpp"
 #include "GameEngine.hpp"
 #include "Move.hpp"
+#include "Zobrist.hpp"
 
 #include <nlohmann/json.hpp>
 #include <glog/logging.h>
 
+#include <array>
+#include <charconv>
 #include <cstdint>
 #include <optional>
-#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 namespace {
 
-std::vector<std::string> split_string(
-    const std::string & x,
-    const std::string delim
-) {
-    std::vector<std::string> chunks {};
-    auto start = 0U;
-    auto end = x.find(delim);
-    while (end != std::string::npos) {
-        chunks.push_back(x.substr(start, end - start));
-        start = end + delim.length();
-        end = x.find(delim, start);
-    }
-    chunks.push_back(x.substr(start, end - start));
-    return chunks;
-}
-
-std::optional<std::size_t> to_num(std::string const& s) {
-    try {
-        return std::stoull(s);
-    } catch(std::invalid_argument const&) {
-        return std::nullopt;
-    } catch(std::out_of_range const& ex) {
+// the six space separated fields of a fen, views into the original string
+using FenFields = std::array<std::string_view, 6>;
+
+std::optional<FenFields> split_fen_fields(std::string_view fen) {
+    FenFields fields {};
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        std::size_t end = fen.find(' ', start);
+        if ((end == std::string_view::npos) != (i + 1 == fields.size())) {
+            VLOG(2) << "fen invalid because it doesnt have 6 fields";
+            return std::nullopt;
+        }
+        fields[i] = fen.substr(start, end - start);
+        start = end + 1;
+    }
+    return fields;
+}
+
+std::optional<std::size_t> to_num(std::string_view s) {
+    std::size_t result = 0;
+    auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), result);
+    if (s.empty() || error != std::errc() || end != s.data() + s.size()) {
         return std::nullopt;
     }
+    return result;
 }
 
-std::optional<ChessEngineLib::Color> to_color(std::string const& s) {
+std::optional<ChessEngineLib::Color> to_color(std::string_view s) {
     if (s == "w") {
         return ChessEngineLib::Color::White;
     } else if (s == "b") {
@@ -46,7 +52,7 @@ std::optional<ChessEngineLib::Color> to_color(std::string const& s) {
     return std::nullopt;
 }
 
-std::optional<ChessEngineLib::Square> get_square(std::string const& s) {
+std::optional<ChessEngineLib::Square> get_square(std::string_view s) {
     if (s.size() != 2) {
         return std::nullopt;
     }
@@ -95,99 +101,139 @@ std::optional<ChessEngineLib::Piece> parse_piece(char c) {
     }
 }
 
-std::optional<ChessEngineLib::Board::Board2dArray> parse_pieces(std::string const& fen_chunk) {
-    const std::vector<std::string> ranks = split_string(fen_chunk, "/");
-    if (ranks.size() != 8) {
-        VLOG(3) << "didnt find 8 ranks";
-        return std::nullopt;
-    }
-    std::array<std::array<std::optional<ChessEngineLib::Piece>, 8>, 8> grid {};
-    for (std::size_t rank=0; rank < 8; rank++) {
-        std::string pieces = ranks.at(rank);
-        if (pieces.empty() || pieces.size() > 8) {
-            VLOG(3) << "bad rank string = " << pieces;
-            return std::nullopt;
-        }
-        std::uint8_t file = 0;
-        for (char c : pieces) {
-            if (file > 8) {
-                VLOG(3) << "bad file = " << file;
+// piece bitboards indexed by color * 6 + type
+std::optional<std::array<ChessEngineLib::Bitboard, 12>> parse_pieces(std::string_view fen_chunk) {
+    std::array<ChessEngineLib::Bitboard, 12> pieces {};
+    std::uint8_t row = 7;
+    std::uint8_t col = 0;
+    for (char c : fen_chunk) {
+        if (c == '/') {
+            if (col != 8 || row == 0) {
+                VLOG(3) << "bad rank ending at row " << +row << " col " << +col;
                 return std::nullopt;
             }
-            if (c >= '1' && c <= '8') {
-                file += (c - '0');
-            } else if (auto piece = parse_piece(c); piece.has_value()) {
-                assert(file < 8);
-                grid[file][7-rank] = piece.value();
-                file ++;
-            } else {
-                VLOG(3) << "bad character in rank = " << c;
+            row--;
+            col = 0;
+        } else if (c >= '1' && c <= '8') {
+            col += (c - '0');
+            if (col > 8) {
+                VLOG(3) << "too many squares in row " << +row;
                 return std::nullopt;
             }
+        } else if (auto piece = parse_piece(c); piece.has_value() && col < 8) {
+            pieces[piece.value().color * 6 + piece.value().type] |= ChessEngineLib::squareBit({col, row});
+            col++;
+        } else {
+            VLOG(3) << "bad character in rank = " << c;
+            return std::nullopt;
         }
     }
-    return grid;
+    if (row != 0 || col != 8) {
+        VLOG(3) << "didnt find 8 full ranks";
+        return std::nullopt;
+    }
+    return pieces;
 }
 
-void write_grid_fen_chunk(std::ostream& os, ChessEngineLib::Board::Board2dArray const& grid) {
+// Appends to a caller supplied buffer and remembers if anything didnt fit
+class FenWriter {
+public:
+    FenWriter(char* first, char* last): m_position(first), m_last(last) {}
+
+    void put(char c) {
+        if (m_position == nullptr || m_position == m_last) {
+            m_position = nullptr;
+            return;
+        }
+        *m_position = c;
+        m_position++;
+    }
+    void putNumber(std::size_t n) {
+        if (m_position == nullptr) {
+            return;
+        }
+        auto [end, error] = std::to_chars(m_position, m_last, n);
+        m_position = error == std::errc() ? end : nullptr;
+    }
+    // one past the last character written, nullptr if the buffer was too small
+    char* end() const {
+        return m_position;
+    }
+
+private:
+    char* m_position;
+    char* m_last;
+};
+
+void write_fen(FenWriter& writer, ChessEngineLib::Board const& board, bool with_move_numbers) {
+    using namespace ChessEngineLib;
+    // fill a mailbox from the bitboards once instead of asking for every square
+    std::array<char, 64> symbols {};
+    for (std::uint8_t color = Color::Black; color <= Color::White; color++) {
+        for (std::uint8_t type=Piece::Type::Pawn; type <= Piece::Type::King; type++) {
+            char symbol = Piece(static_cast<Piece::Type>(type), static_cast<Color>(color)).fen_symbol();
+            Bitboard pieces = board.pieces(static_cast<Color>(color), static_cast<Piece::Type>(type));
+            while (pieces) {
+                symbols[popLsb(pieces)] = symbol;
+            }
+        }
+    }
     for (std::uint8_t row=7; row <= 7; row--) {
-        std::uint8_t current_gap = 0;
+        char current_gap = 0;
         for (std::uint8_t col=0; col < 8; col++) {
-            if (grid[col][row].has_value()) {
-                if (current_gap != 0) {
-                    os << +current_gap;
-                }
-                os << grid[col][row].value().fen_symbol();
-                current_gap = 0;
-            } else {
-                current_gap ++;
+            char symbol = symbols[row * 8 + col];
+            if (symbol == 0) {
+                current_gap++;
+                continue;
             }
+            if (current_gap != 0) {
+                writer.put('0' + current_gap);
+            }
+            writer.put(symbol);
+            current_gap = 0;
         }
         if (current_gap != 0) {
-            os << +current_gap;
+            writer.put('0' + current_gap);
+        }
+        if (row != 0) {
+            writer.put('/');
         }
-        if (row != 0) { os << "/"; }
     }
-}
 
-void write_next_move_color_fen_chunk(std::ostream& os, ChessEngineLib::Color color) {
-    if (color == ChessEngineLib::Color::White) {
-        os << "w";
-    } else  {
-        os << "b";
-    }
-}
+    writer.put(' ');
+    writer.put(board.getNextMoveColor() == Color::White ? 'w' : 'b');
 
-void write_castling_availability_fen_chunk(std::ostream& os, ChessEngineLib::Board const& board) {
+    writer.put(' ');
     bool atleast_one = false;
-    if (board.isCastlingAvailable(ChessEngineLib::Color::White, ChessEngineLib::Side::KingSide)) {
-        os << "K";
-        atleast_one = true;
-    }
-    if (board.isCastlingAvailable(ChessEngineLib::Color::White, ChessEngineLib::Side::QueenSide)) {
-        os << "Q";
-        atleast_one = true;
-    }
-    if (board.isCastlingAvailable(ChessEngineLib::Color::Black, ChessEngineLib::Side::KingSide)) {
-        os << "k";
-        atleast_one = true;
-    }
-    if (board.isCastlingAvailable(ChessEngineLib::Color::Black, ChessEngineLib::Side::QueenSide)) {
-        os << "q";
-        atleast_one = true;
+    std::array<std::pair<Color, Side>, 4> const castling_order = {{
+        {Color::White, Side::KingSide}, {Color::White, Side::QueenSide},
+        {Color::Black, Side::KingSide}, {Color::Black, Side::QueenSide},
+    }};
+    std::array<char, 4> const castling_symbols = {'K', 'Q', 'k', 'q'};
+    for (std::size_t i = 0; i < castling_order.size(); i++) {
+        if (board.isCastlingAvailable(castling_order[i].first, castling_order[i].second)) {
+            writer.put(castling_symbols[i]);
+            atleast_one = true;
+        }
     }
     if (!atleast_one) {
-        os << "-";
+        writer.put('-');
+    }
+
+    writer.put(' ');
+    if (std::optional<Square> en_passant_square = board.getEnPassantSquare(); en_passant_square.has_value()) {
+        writer.put(en_passant_square.value().pgn_file());
+        writer.put(en_passant_square.value().pgn_rank());
+    } else {
+        writer.put('-');
     }
-}
 
-void write_en_passant_fen_chunk(std::ostream& os, std::optional<ChessEngineLib::Square> const& en_passant_square) {
-    if (!en_passant_square.has_value()) {
-        os << "-";
-        return;
+    if (with_move_numbers) {
+        writer.put(' ');
+        writer.putNumber(board.getHalfMoveClock());
+        writer.put(' ');
+        writer.putNumber(board.getMoveNumber());
     }
-    ChessEngineLib::Square square = en_passant_square.value();
-    os << square.pgn_file() << square.pgn_rank();
 }
 
 }
@@ -198,30 +244,30 @@ Board Board::startingPosBoard() {
     return fromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1").value();
 }
 
-std::optional<Board> Board::fromFen(std::string const& fen) {
+std::optional<Board> Board::fromFen(std::string_view fen) {
     VLOG(2) << "fen = " << fen;
-    std::vector<std::string> chunks = split_string(fen, " ");
-    if (chunks.size() != 6) {
-        VLOG(2) << "fen invalid because chunks.size()=" << chunks.size();
+    std::optional<FenFields> fields = split_fen_fields(fen);
+    if (!fields.has_value()) {
         return std::nullopt;
     }
+    FenFields const& chunks = fields.value();
 
     // parse piece grid
-    std::optional<Board2dArray> grid = parse_pieces(chunks.at(0));
-    if (!grid.has_value()) {
+    std::optional<std::array<Bitboard, 12>> pieces = parse_pieces(chunks[0]);
+    if (!pieces.has_value()) {
         VLOG(2) << "fen invalid because of grid contents";
         return std::nullopt;
     }
 
     // parse next move color
-    std::optional<Color> next_move_color = to_color(chunks.at(1));
+    std::optional<Color> next_move_color = to_color(chunks[1]);
     if (!next_move_color.has_value()) {
         VLOG(2) << "fen invalid because of next_move_color";
         return std::nullopt;
     }
 
     // parse castling availability
-    std::optional<CastlingAvailability> castling_availability = parse_castling_availability(chunks.at(2));
+    std::optional<CastlingAvailability> castling_availability = parse_castling_availability(chunks[2]);
     if (!castling_availability.has_value()) {
         VLOG(2) << "fen invalid because of castling_availability";
         return std::nullopt;
@@ -229,8 +275,8 @@ std::optional<Board> Board::fromFen(std::string const& fen) {
 
     // parse en passant target square
     std::optional<Square> en_passant_square = std::nullopt;
-    if (chunks.at(3) != "-") {
-        en_passant_square = get_square(chunks.at(3));
+    if (chunks[3] != "-") {
+        en_passant_square = get_square(chunks[3]);
         if (!en_passant_square.has_value()) {
             VLOG(2) << "fen invalid because of en_passant_square";
             return std::nullopt;
@@ -238,25 +284,39 @@ std::optional<Board> Board::fromFen(std::string const& fen) {
     }
 
     // parse move clocks
-    std::optional<std::size_t> half_move_clock = to_num(chunks.at(4));
-    std::optional<std::size_t> full_move_number = to_num(chunks.at(5));
+    std::optional<std::size_t> half_move_clock = to_num(chunks[4]);
+    std::optional<std::size_t> full_move_number = to_num(chunks[5]);
     if (!half_move_clock.has_value() || !full_move_number.has_value()) {
         VLOG(2) << "fen invalid because of move number";
         return std::nullopt;
     }
 
     Board board;
-    board.m_grid = grid.value();
+    for (std::uint8_t index = 0; index < 12; index++) {
+        Piece piece(static_cast<Piece::Type>(index % 6), static_cast<Color>(index / 6));
+        Bitboard squares = pieces.value()[index];
+        while (squares) {
+            board.putPiece(piece, popLsb(squares));
+        }
+    }
     board.m_nextMoveColor = next_move_color.value();
     board.m_castlingAvailability = castling_availability.value();
     board.m_halfMoveClock = half_move_clock.value();
     board.m_moveNumber = full_move_number.value();
     board.m_enPassantSquare = en_passant_square;
+    board.m_hash ^= board.stateHash();
     return board;
 }
 
-std::array<std::array<std::optional<Piece>, 8>, 8> const& Board::grid() const {
-    return m_grid;
+Board::Board2dArray Board::grid() const {
+    Board2dArray grid {};
+    for (std::uint8_t index = 0; index < 12; index++) {
+        Piece piece(static_cast<Piece::Type>(index % 6), static_cast<Color>(index / 6));
+        for (Square square: SquareRange(m_pieces[index])) {
+            grid[square.col][square.row] = piece;
+        }
+    }
+    return grid;
 }
 
 Color Board::getNextMoveColor() const {
@@ -287,7 +347,7 @@ std::optional<Square> Board::getEnPassantSquare() const {
     return m_enPassantSquare;
 }
 
-std::optional<Board::CastlingAvailability> Board::parse_castling_availability(std::string const& fen_chunk) {
+std::optional<Board::CastlingAvailability> Board::parse_castling_availability(std::string_view fen_chunk) {
     if (fen_chunk.empty() || (fen_chunk.size() > 4)) {
         return std::nullopt;
     }
@@ -297,7 +357,7 @@ std::optional<Board::CastlingAvailability> Board::parse_castling_availability(st
         return result;
     }
     for (std::size_t i=0; i<fen_chunk.size(); i++) {
-        char c = fen_chunk.at(i);
+        char c = fen_chunk[i];
         if (c == 'k') {
             result.blackKingSide = true;
         } else if (c == 'K') {
@@ -313,26 +373,93 @@ std::optional<Board::CastlingAvailability> Board::parse_castling_availability(st
     return result;
 }
 
-std::optional<Piece> const& Board::at(Square square) const {
-    return m_grid.at(square.col).at(square.row);
+std::optional<Piece> Board::at(Square square) const {
+    assert(square.col < 8 && square.row < 8);
+    Color color = (m_occupancy[Color::Black] & squareBit(square)) ? Color::Black : Color::White;
+    std::optional<Piece::Type> type = typeAt(color, squareIndex(square));
+    if (!type.has_value()) {
+        return std::nullopt;
+    }
+    return Piece(type.value(), color);
+}
+
+void Board::putPiece(Piece const& piece, std::uint8_t square_index) {
+    assert(!(occupancy() & squareBit(square_index)));
+    std::size_t index = piece.color * 6 + piece.type;
+    m_materialKey ^= zobristKeys.material[index][popCount(m_pieces[index])];
+    m_pieces[index] |= squareBit(square_index);
+    m_occupancy[piece.color] |= squareBit(square_index);
+    m_hash ^= zobristKeys.pieces[index][square_index];
+}
+
+void Board::removePiece(Piece const& piece, std::uint8_t square_index) {
+    assert(m_pieces[piece.color * 6 + piece.type] & squareBit(square_index));
+    std::size_t index = piece.color * 6 + piece.type;
+    m_pieces[index] &= ~squareBit(square_index);
+    m_occupancy[piece.color] &= ~squareBit(square_index);
+    m_hash ^= zobristKeys.pieces[index][square_index];
+    m_materialKey ^= zobristKeys.material[index][popCount(m_pieces[index])];
+}
+
+bool Board::isInsufficientMaterial() const {
+    Bitboard heavy_or_pawns = 0;
+    for (Color color: {Color::White, Color::Black}) {
+        heavy_or_pawns |= pieces(color, Piece::Type::Pawn) | pieces(color, Piece::Type::Rook) | pieces(color, Piece::Type::Queen);
+    }
+    if (heavy_or_pawns) {
+        return false;
+    }
+    Bitboard knights = pieces(Color::White, Piece::Type::Knight) | pieces(Color::Black, Piece::Type::Knight);
+    Bitboard bishops = pieces(Color::White, Piece::Type::Bishop) | pieces(Color::Black, Piece::Type::Bishop);
+    if (popCount(knights | bishops) <= 1) {
+        return true;
+    }
+    constexpr Bitboard dark_squares = 0xAA55AA55AA55AA55ull;
+    return !knights && (!(bishops & dark_squares) || !(bishops & ~dark_squares));
+}
+
+std::uint64_t Board::stateHash() const {
+    std::uint64_t hash = 0;
+    if (m_nextMoveColor == Color::White) {
+        hash ^= zobristKeys.whiteToMove;
+    }
+    if (m_castlingAvailability.whiteQueenSide) {
+        hash ^= zobristKeys.castling[0];
+    }
+    if (m_castlingAvailability.whiteKingSide) {
+        hash ^= zobristKeys.castling[1];
+    }
+    if (m_castlingAvailability.blackQueenSide) {
+        hash ^= zobristKeys.castling[2];
+    }
+    if (m_castlingAvailability.blackKingSide) {
+        hash ^= zobristKeys.castling[3];
+    }
+    if (m_enPassantSquare.has_value()) {
+        hash ^= zobristKeys.enPassantCol[m_enPassantSquare.value().col];
+    }
+    return hash;
+}
+
+char* Board::writeFen(char* first, char* last) const {
+    FenWriter writer(first, last);
+    write_fen(writer, *this, true);
+    return writer.end();
 }
 
 std::string Board::fen() const {
-    std::ostringstream oss;
-    oss << *this;
-    return oss.str();
+    std::array<char, maxFenLength> buffer;
+    char* end = writeFen(buffer.data(), buffer.data() + buffer.size());
+    assert(end != nullptr);
+    return std::string(buffer.data(), end);
 }
 
 std::string Board::fenWithoutMoveNumbers() const {
-    std::ostringstream os;
-    write_grid_fen_chunk(os, grid());
-    os << " ";
-    write_next_move_color_fen_chunk(os, getNextMoveColor());
-    os << " ";
-    write_castling_availability_fen_chunk(os, *this);
-    os << " ";
-    write_en_passant_fen_chunk(os, getEnPassantSquare());
-    return os.str();
+    std::array<char, maxFenLength> buffer;
+    FenWriter writer(buffer.data(), buffer.data() + buffer.size());
+    write_fen(writer, *this, false);
+    assert(writer.end() != nullptr);
+    return std::string(buffer.data(), writer.end());
 }
 
 bool Board::CastlingAvailability::operator==(const Board::CastlingAvailability& other) const {
@@ -345,7 +472,7 @@ bool Board::CastlingAvailability::operator==(const Board::CastlingAvailability&
 
 bool Board::operator==(const Board& other) const {
     return
-        (grid() == other.grid()) &&
+        (m_pieces == other.m_pieces) &&
         (m_castlingAvailability == other.m_castlingAvailability) &&
         (getNextMoveColor() == other.getNextMoveColor()) &&
         (getMoveNumber() == other.getMoveNumber()) &&
@@ -358,15 +485,10 @@ bool Board::operator!=(const Board& other) const {
 }
 
 std::ostream & operator<<(std::ostream &os, Board const& b) {
-    write_grid_fen_chunk(os, b.grid());
-    os << " ";
-    write_next_move_color_fen_chunk(os, b.getNextMoveColor());
-    os << " ";
-    write_castling_availability_fen_chunk(os, b);
-    os << " ";
-    write_en_passant_fen_chunk(os, b.getEnPassantSquare());
-    os << " " << b.getHalfMoveClock();
-    os << " " << b.getMoveNumber();
+    std::array<char, Board::maxFenLength> buffer;
+    char* end = b.writeFen(buffer.data(), buffer.data() + buffer.size());
+    assert(end != nullptr);
+    os.write(buffer.data(), end - buffer.data());
     return os;
 }
 
@@ -384,90 +506,164 @@ void Board::expireCastlingAvailability(Color color, Side side) {
 
 // No validation done whether the move is legal or not
 void Board::forceMakeMove(Move const& move) {
-    VLOG(6) << "Asked to forceMakeMove move " << move << " on board " << *this;
-    Piece piece = at(move.fromSquare).value();
+    makeMove(move);
+}
+
+Board::UndoInfo Board::makeMove(Move const& move) {
+    // by the color of the piece rather than the side to move, so forceMakeMove keeps working for either
+    if (m_occupancy[Color::White] & squareBit(move.fromSquare)) {
+        return makeMoveFor<Color::White>(move);
+    }
+    return makeMoveFor<Color::Black>(move);
+}
+
+std::optional<Piece::Type> Board::typeAt(Color color, std::uint8_t square_index) const {
+    Bitboard bit = squareBit(square_index);
+    if (!(m_occupancy[color] & bit)) {
+        return std::nullopt;
+    }
+    for (std::uint8_t type=Piece::Type::Pawn; type <= Piece::Type::King; type++) {
+        if (m_pieces[color * 6 + type] & bit) {
+            return static_cast<Piece::Type>(type);
+        }
+    }
+    assert(false);
+    return std::nullopt;
+}
+
+template <Color Us>
+Board::UndoInfo Board::makeMoveFor(Move const& move) {
+    VLOG(6) << "Asked to makeMove move " << move << " on board " << *this;
+    constexpr Color them = Us == Color::White ? Color::Black : Color::White;
+    constexpr int pawn_direction = Us == Color::White ? 8 : -8;
+    constexpr std::uint8_t home_row = Us == Color::White ? 0 : 7;
+    std::uint8_t const from = squareIndex(move.fromSquare);
+    std::uint8_t const to = squareIndex(move.toSquare);
+    Piece const piece {typeAt(Us, from).value(), Us};
+    std::optional<Piece::Type> const captured = typeAt(them, to);
+    UndoInfo undo {captured, m_castlingAvailability, m_enPassantSquare, m_halfMoveClock, m_hash};
+    m_hash ^= stateHash();
     m_nextMoveColor = m_nextMoveColor == Color::Black ? Color::White : Color::Black;
-    bool is_capture = at(move.toSquare).has_value();
+    bool is_capture = captured.has_value();
     bool is_pawn_move = piece.type == Piece::Type::Pawn;
     if (is_capture || is_pawn_move) {
         m_halfMoveClock = 0;
     } else {
         m_halfMoveClock ++;
     }
-    if (is_capture) {
-        assert(at(move.toSquare).value().color != piece.color);
-    }
-    if (piece.color == Color::Black) {
+    if constexpr (Us == Color::Black) {
         m_moveNumber ++;
     }
     if (piece.type == Piece::Type::King) {
-        expireCastlingAvailability(piece.color, Side::KingSide);
-        expireCastlingAvailability(piece.color, Side::QueenSide);
+        expireCastlingAvailability(Us, Side::KingSide);
+        expireCastlingAvailability(Us, Side::QueenSide);
     }
-    if (piece.type == Piece::Type::Rook) {
+    if (piece.type == Piece::Type::Rook && move.fromSquare.row == home_row) {
         if (move.fromSquare.col == 0) {
-            expireCastlingAvailability(piece.color, Side::QueenSide);
+            expireCastlingAvailability(Us, Side::QueenSide);
         } else if (move.fromSquare.col == 7) {
-            expireCastlingAvailability(piece.color, Side::KingSide);
+            expireCastlingAvailability(Us, Side::KingSide);
         }
     }
-    if (is_capture && at(move.toSquare).value().type == Piece::Type::Rook) {
+    // only a capture on their rooks' starting corners can take their castling away
+    if (is_capture && captured.value() == Piece::Type::Rook && move.toSquare.row == 7 - home_row) {
         if (move.toSquare.col == 0) {
-            expireCastlingAvailability(at(move.toSquare).value().color, Side::QueenSide);
+            expireCastlingAvailability(them, Side::QueenSide);
         } else if (move.toSquare.col == 7) {
-            expireCastlingAvailability(at(move.toSquare).value().color, Side::KingSide);
+            expireCastlingAvailability(them, Side::KingSide);
         }
     }
 
-    if (piece.type == Piece::Type::Pawn &&
-        m_enPassantSquare.has_value() &&
-        move.toSquare == m_enPassantSquare.value()
-    ) {
-        assert(!at(m_enPassantSquare.value()).has_value());
-        m_grid[move.toSquare.col][move.fromSquare.row] = std::nullopt;
+    if (is_pawn_move && m_enPassantSquare.has_value() && move.toSquare == m_enPassantSquare.value()) {
+        assert(!is_capture);
+        removePiece(Piece(Piece::Type::Pawn, them), static_cast<std::uint8_t>(to - pawn_direction));
+        undo.capturedType = Piece::Type::Pawn;
     }
 
-    if (piece.type == Piece::Type::Pawn && std::abs(move.fromSquare.row - move.toSquare.row) == 2) {
-        std::uint8_t pawn_direction = piece.color == Color::Black ? -1 : 1;
-        m_enPassantSquare = Square({move.fromSquare.col, static_cast<uint8_t>(move.fromSquare.row + pawn_direction)});
+    if (is_pawn_move && to - from == 2 * pawn_direction) {
+        m_enPassantSquare = squareAt(static_cast<std::uint8_t>(from + pawn_direction));
     } else {
         m_enPassantSquare = std::nullopt;
     }
 
-    m_grid[move.fromSquare.col][move.fromSquare.row] = std::nullopt;
-    m_grid[move.toSquare.col][move.toSquare.row] = piece;
+    removePiece(piece, from);
+    if (is_capture) {
+        removePiece(Piece {captured.value(), them}, to);
+    }
+    if (move.promotionTo.has_value()) {
+        assert(is_pawn_move);
+        assert(move.toSquare.row == 7 - home_row);
+        assert(move.promotionTo.value() != Piece::Type::Pawn);
+        assert(move.promotionTo.value() != Piece::Type::King);
+        putPiece(Piece {move.promotionTo.value(), Us}, to);
+    } else {
+        putPiece(piece, to);
+    }
 
     bool is_castling = piece.type == Piece::Type::King && std::abs(move.fromSquare.col - move.toSquare.col) >= 2;
     if (is_castling) {
-        assert(move.fromSquare.row == move.toSquare.row);
-        assert(move.fromSquare.col == 4);
+        assert(from == home_row * 8 + 4);
+        Piece rook {Piece::Type::Rook, Us};
         if (move.toSquare.col == 6) {
-            assert(grid().at(7).at(move.toSquare.row).has_value());
-            assert(grid().at(7).at(move.toSquare.row).value().type == Piece::Type::Rook);
-            assert(!grid().at(5).at(move.toSquare.row).has_value());
-            m_grid[5][move.toSquare.row] = m_grid.at(7).at(move.toSquare.row);
-            m_grid[7][move.toSquare.row] = std::nullopt;
+            assert(pieces(Us, Piece::Type::Rook) & squareBit(home_row * 8 + 7));
+            removePiece(rook, home_row * 8 + 7);
+            putPiece(rook, home_row * 8 + 5);
         } else {
             assert(move.toSquare.col == 2);
-            assert(grid().at(0).at(move.toSquare.row).has_value());
-            assert(grid().at(0).at(move.toSquare.row).value().type == Piece::Type::Rook);
-            assert(!grid().at(1).at(move.toSquare.row).has_value());
-            assert(!grid().at(3).at(move.toSquare.row).has_value());
-            m_grid[3][move.toSquare.row] = m_grid.at(0).at(move.toSquare.row);
-            m_grid[0][move.toSquare.row] = std::nullopt;
+            assert(pieces(Us, Piece::Type::Rook) & squareBit(home_row * 8 + 0));
+            assert(!(occupancy() & squareBit(home_row * 8 + 1)));
+            removePiece(rook, home_row * 8 + 0);
+            putPiece(rook, home_row * 8 + 3);
         }
     }
-    if (move.promotionTo.has_value()) {
-        assert(piece.type == Piece::Type::Pawn);
-        assert(move.toSquare.row == 0 || move.toSquare.row == 7);
-        assert(move.promotionTo.value() != Piece::Type::Pawn);
-        assert(move.promotionTo.value() != Piece::Type::King);
-        m_grid[move.toSquare.col][move.toSquare.row] = Piece {move.promotionTo.value(), piece.color};
+    m_hash ^= stateHash();
+    return undo;
+}
+
+void Board::unmakeMove(Move const& move, UndoInfo const& undo) {
+    VLOG(6) << "Asked to unmakeMove move " << move << " on board " << *this;
+    Color color = m_nextMoveColor == Color::Black ? Color::White : Color::Black;
+    Color captured_color = m_nextMoveColor;
+    Piece landed {typeAt(color, squareIndex(move.toSquare)).value(), color};
+    Piece moved = move.promotionTo.has_value() ? Piece {Piece::Type::Pawn, color} : landed;
+
+    removePiece(landed, squareIndex(move.toSquare));
+    putPiece(moved, squareIndex(move.fromSquare));
+
+    bool is_castling = moved.type == Piece::Type::King && std::abs(move.fromSquare.col - move.toSquare.col) >= 2;
+    if (is_castling) {
+        Piece rook {Piece::Type::Rook, color};
+        if (move.toSquare.col == 6) {
+            removePiece(rook, squareIndex({5, move.toSquare.row}));
+            putPiece(rook, squareIndex({7, move.toSquare.row}));
+        } else {
+            removePiece(rook, squareIndex({3, move.toSquare.row}));
+            putPiece(rook, squareIndex({0, move.toSquare.row}));
+        }
+    }
+
+    if (undo.capturedType.has_value()) {
+        bool is_en_passant = moved.type == Piece::Type::Pawn &&
+            undo.enPassantSquare.has_value() &&
+            move.toSquare == undo.enPassantSquare.value();
+        Square captured_square = is_en_passant ? Square {move.toSquare.col, move.fromSquare.row} : move.toSquare;
+        putPiece(Piece {undo.capturedType.value(), captured_color}, squareIndex(captured_square));
+    }
+
+    m_nextMoveColor = color;
+    if (color == Color::Black) {
+        m_moveNumber --;
     }
+    m_castlingAvailability = undo.castlingAvailability;
+    m_enPassantSquare = undo.enPassantSquare;
+    m_halfMoveClock = undo.halfMoveClock;
+    m_hash = undo.hash;
 }
 
 void Board::setNextMoveColor(Color color) {
+    m_hash ^= stateHash();
     m_nextMoveColor = color;
+    m_hash ^= stateHash();
 }
 
 }
@@ -4,11 +4,13 @@
 #include "Move.hpp"
 #include "glog/logging.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <exception>
 #include <optional>
 #include <stdexcept>
+#include <string_view>
 
 namespace {
 
@@ -96,137 +98,79 @@ std::optional<std::pair<Game::SevenTagRoster, std::size_t>> parseRoster(std::str
     return std::make_optional<std::pair<Game::SevenTagRoster, std::size_t>>(roster, i);
 }
 
-Piece::Type from_pgn_to_piece_type(char c) {
-    switch(c) {
-        case 'K':
-            return Piece::Type::King;
-        case 'Q':
-            return Piece::Type::Queen;
-        case 'B':
-            return Piece::Type::Bishop;
-        case 'R':
-            return Piece::Type::Rook;
-        case 'N':
-            return Piece::Type::Knight;
-        default:
-            return Piece::Type::Pawn;
-    }
-}
-
-std::optional<Square> find_src_square(
-    Board const& board, Piece const& piece, Square to,
-    std::optional<Piece::Type> const& promotionTo
-) {
-    for (std::uint8_t col=0; col < 8; col++) {
-        for (std::uint8_t row=0; row < 8; row++) {
-            if (
-                auto const& opt = board.at(Square {col, row});
-                opt.has_value() && opt.value() == piece
-            ) {
-                Move mv = {{col, row}, to, promotionTo};
-                if (isMoveLegal(board, std::move(mv))) {
-                    return Square {col, row};
-                }
-            }
-        }
-    }
-    return std::nullopt;
+// Context of a move parseSan resolved from san, with the flags as the san text has them.
+// parseSan already rejected anything malformed, so the text is only looked at, not checked.
+Game::MoveWithContext san_move_context(Board const& board, Move const& move, std::string_view san) {
+    Color color = board.getNextMoveColor();
+    Piece piece {board.typeAt(color, squareIndex(move.fromSquare)).value(), color};
+    bool isCheck = false;
+    bool isCheckmate = false;
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        isCheck = isCheck || san.back() == '+';
+        isCheckmate = isCheckmate || san.back() == '#';
+        san.remove_suffix(1);
+    }
+    if (san.front() == 'O' || san.front() == '0') {
+        Side side = move.toSquare.col == 2 ? Side::QueenSide : Side::KingSide;
+        return Game::MoveWithContext {move, piece, false, isCheck, isCheckmate, false, false, side};
+    }
+    if (move.promotionTo.has_value()) {
+        san.remove_suffix(1);
+        san.remove_suffix(san.back() == '=' ? 1 : 0);
+    }
+    // what is left in front of the destination square: piece letter, source file and rank, capture
+    san.remove_suffix(2);
+    bool isCapture = false;
+    bool isSrcFileAmbigious = false;
+    bool isSrcRankAmbigious = false;
+    for (char c: san) {
+        isCapture = isCapture || c == 'x';
+        isSrcFileAmbigious = isSrcFileAmbigious || (c >= 'a' && c <= 'h');
+        isSrcRankAmbigious = isSrcRankAmbigious || (c >= '1' && c <= '8');
+    }
+    return Game::MoveWithContext {move, piece, isCapture, isCheck, isCheckmate, isSrcFileAmbigious, isSrcRankAmbigious, std::nullopt};
 }
 
-std::optional<std::uint8_t> find_src_row(
-    Board const& board, Piece const& piece, Square to, std::uint8_t from_col,
-    std::optional<Piece::Type> const& promotionTo
-) {
-    VLOG(7) << "finding src row for " << piece << " to " << to;
-    for (std::uint8_t row=0; row < 8; row++) {
-        if (
-            auto const& opt = board.at(Square {from_col, row});
-            opt.has_value() && opt.value() == piece
-        ) {
-            Move mv = {{from_col, row}, to, promotionTo};
-            if (isMoveLegal(board, std::move(mv))) {
-                return row;
-            }
-        }
+// Appends the key of the position board is in and tells whether it has now occurred three times.
+// Nothing from before the last capture or pawn move can come back, so those keys are dropped, and only
+// positions with the same side to move can be equal, so only every second key is looked at.
+bool push_position_key(std::vector<std::uint64_t>& position_keys, Board const& board) {
+    std::uint64_t key = board.hash();
+    if (board.getHalfMoveClock() == 0) {
+        position_keys.clear();
     }
-    return std::nullopt;
-}
-
-std::optional<std::uint8_t> find_src_col(
-    Board const& board, Piece const& piece, Square to, std::uint8_t from_row,
-    std::optional<Piece::Type> const& promotionTo
-) {
-    VLOG(7) << "finding src column for " << piece << " to " << to;
-    for (std::uint8_t col=0; col < 8; col++) {
-        if (
-            auto const& opt = board.at(Square {col, from_row});
-            opt.has_value() && opt.value() == piece
-        ) {
-            Move mv = {{col, from_row}, to, promotionTo};
-            if (isMoveLegal(board, std::move(mv))) {
-                return col;
-            }
+    position_keys.push_back(key);
+    std::size_t reach = std::min(board.getHalfMoveClock(), position_keys.size() - 1);
+    int occurrences = 1;
+    for (std::size_t back = 4; back <= reach; back += 2) {
+        if (position_keys[position_keys.size() - 1 - back] == key && ++occurrences >= 3) {
+            return true;
         }
     }
-    return std::nullopt;
+    return false;
 }
 
-bool set_src_square(
-    Board const& board, Piece const& piece, Square to, Square& from,
-    bool srcRowAlreadyKnown, bool srcColAlreadyKnown,
-    std::optional<Piece::Type> const& promotionTo
-) {
-
-    VLOG(6) << "setting src square for piece " << piece << " to " << to;
-    if (srcRowAlreadyKnown && srcColAlreadyKnown) {
-        return true;
-    }
-    if (!srcRowAlreadyKnown && !srcColAlreadyKnown) {
-        std::optional<Square> src = find_src_square(board, piece, to, promotionTo);
-        if (src.has_value()) {
-            from = src.value();
-        }
-        return src.has_value();
+// keeps a copy of the board after every checkpoint_interval plies, plies counting the move just made
+void push_checkpoint(std::vector<Board>& checkpoints, std::size_t checkpoint_interval, std::size_t plies, Board const& board) {
+    if (plies % checkpoint_interval == 0) {
+        checkpoints.push_back(board);
     }
-    if (!srcRowAlreadyKnown) {
-        std::optional<std::uint8_t> src_rank = find_src_row(board, piece, to, from.col, promotionTo);
-        if (src_rank.has_value()) {
-            from.row = src_rank.value();
-        }
-        return src_rank.has_value();
-    }
-    if (!srcColAlreadyKnown) {
-        std::optional<std::uint8_t> src_file = find_src_col(board, piece, to, from.row, promotionTo);
-        if (src_file.has_value()) {
-            from.col = src_file.value();
-        }
-        return src_file.has_value();
-    }
-    throw std::runtime_error("Should not reach this part of the code");
-}
-
-bool increment_repetition(std::unordered_map<std::string, std::size_t>& repetitions, Board const& board) {
-    std::string key = board.fenWithoutMoveNumbers();
-    if (repetitions.count(key) == 0) {
-        repetitions[key] = 1;
-    } else {
-        repetitions[key] = repetitions.at(key) + 1;
-    }
-    return repetitions[key] >= 3;
 }
 
 struct ParseMovesEtcResult {
-    std::vector<Game::MoveWithContext> moves;
+    std::vector<Game::PackedMoveWithContext> moves;
     std::optional<ResultType> result;
-    std::unordered_map<std::string, std::size_t> repetitions;
+    std::vector<std::uint64_t> position_keys;
+    std::vector<Board> checkpoints;
 };
 
 std::optional<ParseMovesEtcResult> parseMovesAndResult(
-    std::string const& pgn, std::size_t i, Board& board
+    std::string const& pgn, std::size_t i, Board& board, std::size_t checkpoint_interval
 ) {
-    std::vector<Game::MoveWithContext> moves {};
+    std::vector<Game::PackedMoveWithContext> moves {};
     std::optional<ResultType> result {};
-    std::unordered_map<std::string, std::size_t> repetitions {};
+    std::vector<std::uint64_t> position_keys {board.hash()};
+    std::vector<Board> checkpoints {board};
 
     auto skip_comment = [](std::size_t i, std::string const& pgn) {
         VLOG(6) << "asked to skip comment from i=" << i;
@@ -280,16 +224,6 @@ std::optional<ParseMovesEtcResult> parseMovesAndResult(
     auto parse_move = [] (
         std::size_t i, std::string const& pgn, Color color, Board& board
     ) -> std::optional<std::pair<std::size_t, Game::MoveWithContext>> {
-        Square from {0,0};
-        Square to {0,0};
-        Piece::Type type = Piece::Type::Pawn;
-        bool isCapture = false;
-        bool isCheck = false;
-        bool isCheckmate = false;
-        bool isSrcFileAmbigious = false;
-        bool isSrcRankAmbigious = false;
-        std::optional<Side> isCastle = std::nullopt;
-        std::optional<Piece::Type> promotionTo = std::nullopt;
         if (i >= pgn.size()) {
             return std::nullopt;
         }
@@ -300,111 +234,18 @@ std::optional<ParseMovesEtcResult> parseMovesAndResult(
         }
         std::string chunk = pgn.substr(init_i, i-init_i);
         VLOG(3) << "chunk = " << chunk;
-        if (chunk.size() < 2) {
-            VLOG(3) << "got chunk smaller than 2 chars";
-            return std::nullopt;
-        }
-        std::size_t j=chunk.size()-1;
-        char c = chunk.at(j);
-        if (c == '#') {
-            isCheckmate = true;
-            j--;
-        } else if (c == '+') {
-            isCheck = true;
-            j--;
-        }
-
-        if (chunk.substr(0,j+1) == "O-O" || chunk.substr(0, j+1) == "O-O-O") {
-            type = Piece::Type::King;
-            from.col = 4;
-            from.row = color == Color::White ? 0 : 7;
-            to.row = from.row;
-            if (chunk.substr(0, j+1) == "O-O-O") {
-                to.col = 2;
-                isCastle = std::make_optional(Side::QueenSide);
-            } else {
-                to.col = 6;
-                isCastle = std::make_optional(Side::KingSide);
-            }
-            Piece piece {type, color};
-            Move move {from, to, promotionTo};
-            Game::MoveWithContext mv {move, piece, isCapture, isCheck, isCheckmate, isSrcFileAmbigious, isSrcRankAmbigious, isCastle};
-            bool is_valid = makeMove(board, move);
-            if (!is_valid) {
-                VLOG(3) << "castling determined to be illegal";
-                return std::nullopt;
-            }
-            return std::pair(i, mv);
-        }
-
-        c = chunk.at(j);
-        if ((c == 'Q') || (c == 'N') || (c == 'R') || (c == 'B')) {
-            VLOG(7) << "parsing promotion piece from char " << c;
-            promotionTo = std::make_optional(from_pgn_to_piece_type(c));
-            j--;
-            if (chunk.at(j) != '=') {
-                VLOG(3) << "expected equals symbol to signal promotion, return nullopt";
-                return std::nullopt;
-            }
-            j--;
-        }
-
-        c = chunk.at(j);
-        if (!std::isdigit(c)) {
-            VLOG(3) << "didnt get correct to row digit";
-            return std::nullopt;
-        }
-        to.row = c - '1';
-        j--;
-
-        c = chunk.at(j);
-        if (!(c >= 'a' && c <= 'h')) {
-            VLOG(3) << "didnt get correct to col alphabet";
-            return std::nullopt;
-        }
-        to.col = c - 'a';
-        j--;
-
-        if (j < chunk.size() && chunk.at(j) == 'x') {
-            VLOG(7) << "parsing capture";
-            isCapture = true;
-            j--;
-        }
-        if (j < chunk.size() && std::isdigit(chunk.at(j))) {
-            VLOG(7) << "parsing src row";
-            from.row = chunk.at(j) - '1';
-            isSrcRankAmbigious = true;
-            j--;
-        }
-        if (j < chunk.size() && chunk.at(j) >= 'a' && chunk.at(j) <= 'h') {
-            VLOG(7) << "parsing src col";
-            from.col = chunk.at(j) - 'a';
-            isSrcFileAmbigious = true;
-            j--;
-        }
-        if (j < chunk.size() && std::isalpha(chunk.at(j))) {
-            VLOG(7) << "parsing type from char from chunk=" << chunk << " at j=" << j << " which is " << chunk.at(j);
-            type = from_pgn_to_piece_type(chunk.at(j));
-            j--;
-        }
-
-        if (j < chunk.size()) {
-            VLOG(3) << "Expected to have processed all chars in the chunk but more left";
-            return std::nullopt;
-        }
-
-        Piece piece {type, color};
-        if (!set_src_square(board, piece, to, from, isSrcRankAmbigious, isSrcFileAmbigious, promotionTo)) {
-            VLOG(3) << "Couldnt infer the source square for move";
+        if (board.getNextMoveColor() != color) {
+            VLOG(3) << "expected a move by the other side";
             return std::nullopt;
         }
-        Move move {from, to, promotionTo};
-        Game::MoveWithContext mv {move, piece, isCapture, isCheck, isCheckmate, isSrcFileAmbigious, isSrcRankAmbigious, isCastle};
-        bool is_valid = makeMove(board, move);
-        if (!is_valid) {
-            VLOG(3) << "move determined to be illegal" << std::endl;
+        std::optional<Move> resolved = parseSan(board, chunk);
+        if (!resolved.has_value()) {
+            VLOG(3) << "couldnt resolve san " << chunk << " to a legal move";
             return std::nullopt;
         }
+        Move move = resolved.value();
+        Game::MoveWithContext mv = san_move_context(board, move, chunk);
+        board.forceMakeMove(move);
         return std::pair(i, mv);
     };
 
@@ -471,8 +312,9 @@ std::optional<ParseMovesEtcResult> parseMovesAndResult(
             return std::nullopt;
         }
         i = res.value().first;
-        moves.push_back(res.value().second);
-        [[maybe_unused]] bool repeated_thrice = increment_repetition(repetitions, board);
+        moves.emplace_back(res.value().second);
+        [[maybe_unused]] bool repeated_thrice = push_position_key(position_keys, board);
+        push_checkpoint(checkpoints, checkpoint_interval, moves.size(), board);
         // TODO: use this value somehow?
 
         if(i<pgn.size() && std::isalnum(pgn.at(i))) {
@@ -496,8 +338,9 @@ std::optional<ParseMovesEtcResult> parseMovesAndResult(
             return std::nullopt;
         }
         i = res.value().first;
-        moves.push_back(res.value().second);
-        repeated_thrice = increment_repetition(repetitions, board);
+        moves.emplace_back(res.value().second);
+        repeated_thrice = push_position_key(position_keys, board);
+        push_checkpoint(checkpoints, checkpoint_interval, moves.size(), board);
         // TODO: use this value somehow?
 
         if(i<pgn.size() && std::isalnum(pgn.at(i))) {
@@ -505,14 +348,14 @@ std::optional<ParseMovesEtcResult> parseMovesAndResult(
             return std::nullopt;
         }
     }
-    if (!moves.empty() && moves.back().isCheckmate) {
-        if (moves.back().piece.color == Color::White) {
+    if (!moves.empty() && moves.back().toMoveWithContext().isCheckmate) {
+        if (moves.back().toMoveWithContext().piece.color == Color::White) {
             result = ResultType::WhiteWin;
         } else {
             result = ResultType::BlackWin;
         }
     }
-    return std::make_optional(ParseMovesEtcResult {moves, result, repetitions});
+    return std::make_optional(ParseMovesEtcResult {moves, result, position_keys, checkpoints});
 }
 
 std::string to_pgn_string(std::optional<ResultType> result) {
@@ -620,62 +463,14 @@ std::string to_pgn_string(std::vector<Game::MoveWithContext> const& moves) {
     return result;
 }
 
-std::pair<bool, bool> is_ambigious_src(Board const& board, Move const& move) {
-    bool is_col_ambig = false;
-    bool is_row_ambig = false;
-    Piece piece = board.at(move.fromSquare).value();
-    for (std::uint8_t col=0; col<8; col++) {
-        for (std::uint8_t row=0; row<8; row++) {
-            if (col == move.fromSquare.col && row == move.fromSquare.row) {
-                continue;
-            }
-            auto opt = board.at({col, row});
-            if (!opt.has_value() || opt.value() != piece) {
-                continue;
-            }
-            if (!isMoveLegal(board, Move({col, row}, move.toSquare, move.promotionTo))) {
-                continue;
-            }
-            if (col != move.fromSquare.col) {
-                is_col_ambig = true;
-                continue;
-            }
-            is_row_ambig = true;
-        }
-    }
-    return std::make_pair(is_col_ambig, is_row_ambig);
-}
-
-
-std::optional<std::pair<Game::MoveWithContext, std::optional<ResultType>>> create_move_with_context_and_make_move(
-    Board& board, Move const& move
-) {
-    Board board_copy = board;
-    bool success = makeMove(board_copy, move);
-    if (!success) {
-        return std::nullopt;
-    }
-
-    Piece piece = board.at(move.fromSquare).value();
-
-    auto result_opt = isGameOver(board_copy);
-    bool isCheckmate = result_opt.has_value() && result_opt.value() != ResultType::Draw;
-
-    bool isCheck = false;
-    if (!isCheckmate) {
-        Board board_if_current_player_had_2_moves = board_copy;
-        board_if_current_player_had_2_moves.setNextMoveColor(piece.color);
-        isCheck = isKingCapturePossibleNextMove(board_if_current_player_had_2_moves);
-    }
-
-    bool isCapture = board.at(move.toSquare).has_value();
-
-    auto is_ambigious_pair = is_ambigious_src(board, move);
-    bool isSrcFileAmbigious = is_ambigious_pair.first;
-    bool isSrcRankAmbigious = is_ambigious_pair.second;
-    if (isCapture && piece.type == Piece::Type::Pawn) {
-        isSrcFileAmbigious = true;
-    }
+// Context of a legal move which is cheap to tell before making it. Whether it checks or mates and the rest
+// of the disambiguation are filled in by Game::makeLegalMove and Game::annotatedMoves.
+Game::MoveWithContext unannotated_move_context(Board const& board, Move const& move) {
+    Color color = board.getNextMoveColor();
+    Color enemy_color = color == Color::White ? Color::Black : Color::White;
+    Piece piece {board.typeAt(color, squareIndex(move.fromSquare)).value(), color};
+    bool isCapture = board.typeAt(enemy_color, squareIndex(move.toSquare)).has_value();
+    bool isSrcFileAmbigious = isCapture && piece.type == Piece::Type::Pawn;
 
     std::optional<Side> isCastle = std::nullopt;
     if (piece.type == Piece::Type::King && (std::abs(move.fromSquare.col - move.toSquare.col) >= 2)) {
@@ -686,25 +481,35 @@ std::optional<std::pair<Game::MoveWithContext, std::optional<ResultType>>> creat
             isCastle = Side::KingSide;
         }
     }
+    return Game::MoveWithContext {move, piece, isCapture, false, false, isSrcFileAmbigious, false, isCastle};
+}
 
-    Game::MoveWithContext mv {move, piece, isCapture, isCheck, isCheckmate, isSrcFileAmbigious, isSrcRankAmbigious, isCastle};
-    board = board_copy;
-    return std::make_pair(mv, result_opt);
+// fills in what unannotated_move_context left out, board is the position the move was made in
+void annotate_move_context(Game::MoveWithContext& mv, Board const& board) {
+    mv.isCheck = !mv.isCheckmate && givesCheck(board, mv.move);
+    auto [is_file_needed, is_rank_needed] = sanDisambiguation(board, mv.move);
+    mv.isSrcFileAmbigious = mv.isSrcFileAmbigious || is_file_needed;
+    mv.isSrcRankAmbigious = is_rank_needed;
 }
 
 }
 
 namespace ChessEngineLib {
 
-Game::Game()
+Game::Game(): Game(defaultCheckpointInterval) {}
+
+Game::Game(std::size_t checkpointInterval)
 : roster_ {},
 moves_{},
 result_ {std::nullopt},
 board_ {Board::startingPosBoard()},
-repetitions_{{board_.fenWithoutMoveNumbers(), 1}}
+positionKeys_ {board_.hash()},
+checkpointInterval_ {std::max(checkpointInterval, std::size_t {1})},
+checkpoints_ {board_},
+annotatedPlies_ {0}
 {}
 
-std::optional<Game> Game::fromPgn(std::string const& pgn) {
+std::optional<Game> Game::fromPgn(std::string const& pgn, std::size_t checkpointInterval) {
     VLOG(2) << "fromPgn called with pgn of size = " << pgn.size();
     std::optional<std::pair<SevenTagRoster, std::size_t>> roster = parseRoster(pgn);
     if (!roster.has_value()) {
@@ -714,8 +519,8 @@ std::optional<Game> Game::fromPgn(std::string const& pgn) {
     std::size_t i = roster.value().second;
     VLOG(2) << "calling parseMoves from i = " << i;
 
-    Game game {};
-    auto moves_optional = parseMovesAndResult(pgn, i, game.board_);
+    Game game {checkpointInterval};
+    auto moves_optional = parseMovesAndResult(pgn, i, game.board_, game.checkpointInterval_);
     if (!moves_optional.has_value()) {
         return std::nullopt;
     }
@@ -723,7 +528,10 @@ std::optional<Game> Game::fromPgn(std::string const& pgn) {
     game.roster_ = roster.value().first;
     game.moves_ = moves_optional.value().moves;
     game.result_ = moves_optional.value().result;
-    game.repetitions_ = moves_optional.value().repetitions;
+    game.positionKeys_ = moves_optional.value().position_keys;
+    game.checkpoints_ = moves_optional.value().checkpoints;
+    // the pgn already says how each move was disambiguated
+    game.annotatedPlies_ = game.moves_.size();
     if (game.result_.has_value()) {
         game.roster_.result = game.result_;
     }
@@ -731,7 +539,7 @@ std::optional<Game> Game::fromPgn(std::string const& pgn) {
 }
 
 std::string Game::toPgn(bool with_roster) const {
-    std::string movesPgnStr = to_pgn_string(moves_);
+    std::string movesPgnStr = to_pgn_string(annotatedMoves(moves_.size()));
     if (result_.has_value()) {
         movesPgnStr += " " + to_pgn_string(result_);
     }
@@ -762,31 +570,135 @@ std::optional<Game::MoveWithContext> Game::moveAt(std::size_t halfMoveNum) const
     if (halfMoveNum-1 >= moves_.size()) {
         return std::nullopt;
     }
-    return moves_.at(halfMoveNum-1);
+    MoveWithContext mv = moves_.at(halfMoveNum-1).toMoveWithContext();
+    if (halfMoveNum > annotatedPlies_) {
+        annotate_move_context(mv, boardAt(halfMoveNum-1).value());
+    }
+    return mv;
 }
 
 Board const& Game::board() const {
     return board_;
 }
 
+std::optional<Board> Game::boardAt(std::size_t ply) const {
+    if (ply > moves_.size()) {
+        return std::nullopt;
+    }
+    std::size_t checkpoint = ply / checkpointInterval_;
+    Board board = checkpoints_.at(checkpoint);
+    for (std::size_t i = checkpoint * checkpointInterval_; i < ply; i++) {
+        board.forceMakeMove(moves_[i].toMoveWithContext().move);
+    }
+    return board;
+}
+
+bool Game::undo() {
+    if (moves_.empty()) {
+        return false;
+    }
+    moves_.pop_back();
+    if (checkpoints_.size() > moves_.size() / checkpointInterval_ + 1) {
+        checkpoints_.pop_back();
+    }
+    board_ = boardAt(moves_.size()).value();
+    // the keys may have been dropped at the move taken back, so they are gathered again
+    std::size_t first = moves_.size() - std::min(board_.getHalfMoveClock(), moves_.size());
+    Board board = boardAt(first).value();
+    positionKeys_.assign(1, board.hash());
+    for (std::size_t i = first; i < moves_.size(); i++) {
+        board.forceMakeMove(moves_[i].toMoveWithContext().move);
+        positionKeys_.push_back(board.hash());
+    }
+    // no move is made once the game is over, so the game went on from here
+    result_ = std::nullopt;
+    roster_.result = std::nullopt;
+    annotatedPlies_ = std::min(annotatedPlies_, moves_.size());
+    return true;
+}
+
 bool Game::makeMove(Move const& move) {
-    LOG(INFO) << "In Game, making move " << move << " on board "<< board_;
+    VLOG(1) << "In Game, making move " << move << " on board "<< board_;
     if (result_.has_value()) {
         LOG(INFO) << "Game already over my guy, cannot make move " << move;
         return false;
     }
-    std::optional<std::pair<MoveWithContext, std::optional<ResultType>>> mv =
-        create_move_with_context_and_make_move(board_, move);
-    if (!mv.has_value()) {
+    if (!isMoveLegal(board_, move)) {
+        VLOG(1) << "move " << move << " is illegal";
         return false;
     }
-    moves_.push_back(mv.value().first);
-    result_ = mv.value().second;
-    bool repeated_thrice = increment_repetition(repetitions_, board_);
+    makeLegalMove(move);
+    return true;
+}
+
+void Game::makeLegalMove(Move const& move) {
+    assert(!result_.has_value());
+    assert(isMoveLegal(board_, move));
+    MoveWithContext mv = unannotated_move_context(board_, move);
+    board_.forceMakeMove(move);
+    result_ = isGameOver(board_);
+    mv.isCheckmate = result_.has_value() && result_.value() != ResultType::Draw;
+    moves_.emplace_back(mv);
+    push_checkpoint(checkpoints_, checkpointInterval_, moves_.size(), board_);
+    bool repeated_thrice = push_position_key(positionKeys_, board_);
     if (repeated_thrice && !result_.has_value()) {
         result_ = std::make_optional(ResultType::Draw);
     }
-    return true;
+}
+
+bool Game::hasUpcomingRepetition() const {
+    return ChessEngineLib::hasUpcomingRepetition(board_, positionKeys_);
+}
+
+std::vector<Game::MoveWithContext> Game::annotatedMoves(std::size_t plies) const {
+    std::vector<MoveWithContext> moves;
+    moves.reserve(plies);
+    for (std::size_t i = 0; i < plies; i++) {
+        moves.push_back(moves_[i].toMoveWithContext());
+    }
+    if (annotatedPlies_ >= plies) {
+        return moves;
+    }
+    Board board = boardAt(annotatedPlies_).value();
+    for (std::size_t i = annotatedPlies_; i < plies; i++) {
+        annotate_move_context(moves.at(i), board);
+        board.forceMakeMove(moves.at(i).move);
+    }
+    return moves;
+}
+
+static_assert(sizeof(Game::PackedMoveWithContext) == 4, "a stored ply takes four bytes");
+
+Game::PackedMoveWithContext::PackedMoveWithContext(MoveWithContext const& mv)
+: move_ {mv.isCastle.has_value()
+    ? PackedMove(squareIndex(mv.move.fromSquare), squareIndex(mv.move.toSquare), PackedMove::Kind::Castle)
+    : PackedMove(mv.move)},
+pieceType_ {static_cast<std::uint8_t>(mv.piece.type)},
+flags_ {static_cast<std::uint8_t>(
+    (mv.isCapture ? Capture : 0) |
+    (mv.isCheck ? Check : 0) |
+    (mv.isCheckmate ? Checkmate : 0) |
+    (mv.isSrcFileAmbigious ? SrcFileAmbigious : 0) |
+    (mv.isSrcRankAmbigious ? SrcRankAmbigious : 0) |
+    (mv.piece.color == Color::White ? WhitePiece : 0)
+)}
+{}
+
+Game::MoveWithContext Game::PackedMoveWithContext::toMoveWithContext() const {
+    std::optional<Side> isCastle = std::nullopt;
+    if (move_.kind() == PackedMove::Kind::Castle) {
+        isCastle = squareAt(move_.to()).col == 2 ? Side::QueenSide : Side::KingSide;
+    }
+    return MoveWithContext {
+        move_.toMove(),
+        Piece {static_cast<Piece::Type>(pieceType_), (flags_ & WhitePiece) ? Color::White : Color::Black},
+        (flags_ & Capture) != 0,
+        (flags_ & Check) != 0,
+        (flags_ & Checkmate) != 0,
+        (flags_ & SrcFileAmbigious) != 0,
+        (flags_ & SrcRankAmbigious) != 0,
+        isCastle
+    };
 }
 
 Game::MoveWithContext::MoveWithContext(
@@ -1,9 +1,15 @@
 #include "GameEngine.hpp"
+#include "Attacks.hpp"
+#include "Bitboard.hpp"
 #include "Board.hpp"
 #include "Move.hpp"
+#include "MoveList.hpp"
+#include "PackedMove.hpp"
+#include "Zobrist.hpp"
 #include "glog/logging.h"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <limits>
 #include <stdexcept>
@@ -14,128 +20,137 @@
 
 namespace {
 
-std::unordered_set<ChessEngineLib::Square> long_range_piece_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source,
-    std::vector<std::pair<std::uint8_t, std::uint8_t>> const& directions
+ChessEngineLib::Color opposite_color(ChessEngineLib::Color color) {
+    return color == ChessEngineLib::Color::White ? ChessEngineLib::Color::Black : ChessEngineLib::Color::White;
+}
+
+// pieces of either color attacking square, sliders are blocked by occupancy
+ChessEngineLib::Bitboard attackers_to(
+    ChessEngineLib::Board const& board, std::uint8_t square, ChessEngineLib::Bitboard occupancy
 ) {
-    ChessEngineLib::Color piece_color = board.at(source).value().color;
-    std::unordered_set<ChessEngineLib::Square> dests = {};
-    for (auto const& direction: directions) {
-        for (
-            std::uint8_t col=source.col+direction.first, row=source.row+direction.second;
-            (col <= 7) && (row <= 7);
-            col += direction.first, row += direction.second
-        ) {
-            if (!board.grid().at(col).at(row).has_value()) {
-                dests.insert({col, row});
-            } else if (board.grid().at(col).at(row).value().color == piece_color) {
-                break;
-            } else {
-                dests.insert({col, row});
-                break;
-            }
-        }
+    using namespace ChessEngineLib;
+    Bitboard knights = board.pieces(Color::White, Piece::Type::Knight) | board.pieces(Color::Black, Piece::Type::Knight);
+    Bitboard kings = board.pieces(Color::White, Piece::Type::King) | board.pieces(Color::Black, Piece::Type::King);
+    Bitboard queens = board.pieces(Color::White, Piece::Type::Queen) | board.pieces(Color::Black, Piece::Type::Queen);
+    Bitboard rooks = board.pieces(Color::White, Piece::Type::Rook) | board.pieces(Color::Black, Piece::Type::Rook);
+    Bitboard bishops = board.pieces(Color::White, Piece::Type::Bishop) | board.pieces(Color::Black, Piece::Type::Bishop);
+    // a white pawn attacks square if a black pawn on square would attack the white pawn, and vice versa
+    return (pawnAttacks(Color::Black, square) & board.pieces(Color::White, Piece::Type::Pawn)) |
+        (pawnAttacks(Color::White, square) & board.pieces(Color::Black, Piece::Type::Pawn)) |
+        (knightAttacks(square) & knights) |
+        (kingAttacks(square) & kings) |
+        (rookAttacks(square, occupancy) & (rooks | queens)) |
+        (bishopAttacks(square, occupancy) & (bishops | queens));
+}
+
+// same as checking attackers_to against the pieces of by_color, but exits as soon as one attacker is found
+bool is_square_attacked(
+    ChessEngineLib::Board const& board, std::uint8_t square, ChessEngineLib::Color by_color, ChessEngineLib::Bitboard occupancy
+) {
+    using namespace ChessEngineLib;
+    if (pawnAttacks(opposite_color(by_color), square) & board.pieces(by_color, Piece::Type::Pawn)) {
+        return true;
     }
-    return dests;
+    if (knightAttacks(square) & board.pieces(by_color, Piece::Type::Knight)) {
+        return true;
+    }
+    if (kingAttacks(square) & board.pieces(by_color, Piece::Type::King)) {
+        return true;
+    }
+    Bitboard queens = board.pieces(by_color, Piece::Type::Queen);
+    if (rookAttacks(square, occupancy) & (board.pieces(by_color, Piece::Type::Rook) | queens)) {
+        return true;
+    }
+    return bishopAttacks(square, occupancy) & (board.pieces(by_color, Piece::Type::Bishop) | queens);
+}
+
+// whether the king of color is attacked, false if color has no king
+bool is_king_attacked(ChessEngineLib::Board const& board, ChessEngineLib::Color color) {
+    ChessEngineLib::Bitboard king = board.pieces(color, ChessEngineLib::Piece::Type::King);
+    if (!king) {
+        return false;
+    }
+    return is_square_attacked(board, ChessEngineLib::lsbIndex(king), opposite_color(color), board.occupancy());
 }
 
-std::unordered_set<ChessEngineLib::Square> queen_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
+ChessEngineLib::Bitboard queen_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
-    // for each of the 8 directions, move til the end or til encounter a piece
-    return long_range_piece_destinations(board, source, {{-1,-1}, {-1,0}, {-1,1}, {0,-1}, {0,1}, {1,-1}, {1,0}, {1,1}});
+    return ChessEngineLib::queenAttacks(ChessEngineLib::squareIndex(source), board.occupancy()) & ~board.occupancy(color);
 }
 
-std::unordered_set<ChessEngineLib::Square> rook_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
+ChessEngineLib::Bitboard rook_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
-    // for each of the 4 directions, move til the end or til encounter a piece
-    return long_range_piece_destinations(board, source, {{-1,0}, {0,-1}, {0,1}, {1,0}});
+    return ChessEngineLib::rookAttacks(ChessEngineLib::squareIndex(source), board.occupancy()) & ~board.occupancy(color);
 }
 
-std::unordered_set<ChessEngineLib::Square> bishop_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
+ChessEngineLib::Bitboard bishop_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
-    // for each of the 4 directions, move til the end or til encounter a piece
-    return long_range_piece_destinations(board, source, {{-1,-1}, {-1,1}, {1,-1}, {1,1}});
+    return ChessEngineLib::bishopAttacks(ChessEngineLib::squareIndex(source), board.occupancy()) & ~board.occupancy(color);
 }
 
-std::unordered_set<ChessEngineLib::Square> pawn_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
+ChessEngineLib::Bitboard pawn_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
-    ChessEngineLib::Piece piece = board.at(source).value();
-    assert(piece.type == ChessEngineLib::Piece::Type::Pawn);
+    ChessEngineLib::Piece piece {ChessEngineLib::Piece::Type::Pawn, color};
+    assert(board.at(source) == piece);
     assert(source.row != 0 && source.row != 7);
 
     bool spawn_position = piece.color == ChessEngineLib::Color::White ? source.row == 1 : source.row == 6;
     std::int8_t movement_dir = piece.color == ChessEngineLib::Color::White ? 1 : -1;
+    ChessEngineLib::Color enemy_color = piece.color == ChessEngineLib::Color::White ?
+        ChessEngineLib::Color::Black : ChessEngineLib::Color::White;
 
-    std::unordered_set<ChessEngineLib::Square> dests {};
-    if (!board.grid().at(source.col).at(source.row + movement_dir).has_value()) {
-        dests.insert({source.col, static_cast<std::uint8_t>(source.row + movement_dir)});
-        if (spawn_position && !board.grid().at(source.col).at(source.row + movement_dir*2)) {
-            dests.insert({source.col, static_cast<std::uint8_t>(source.row + movement_dir * 2)});
+    ChessEngineLib::Bitboard dests = 0;
+    ChessEngineLib::Square single_step {source.col, static_cast<std::uint8_t>(source.row + movement_dir)};
+    ChessEngineLib::Square double_step {source.col, static_cast<std::uint8_t>(source.row + movement_dir * 2)};
+    if (!(board.occupancy() & ChessEngineLib::squareBit(single_step))) {
+        dests |= ChessEngineLib::squareBit(single_step);
+        if (spawn_position && !(board.occupancy() & ChessEngineLib::squareBit(double_step))) {
+            dests |= ChessEngineLib::squareBit(double_step);
         }
     }
     if (board.getEnPassantSquare().has_value() &&
         board.getEnPassantSquare().value().row == source.row + movement_dir &&
         std::abs(board.getEnPassantSquare().value().col - source.col) <= 1
     ) {
-        dests.insert(board.getEnPassantSquare().value());
-    }
-    // try capture left
-    if ((source.col > 0)) {
-        std::optional<ChessEngineLib::Piece> diagonal_piece = board.grid().at(source.col-1).at(source.row + movement_dir);
-        if (diagonal_piece.has_value() && diagonal_piece.value().color != piece.color) {
-            dests.insert(ChessEngineLib::Square{
-                static_cast<uint8_t>(source.col - 1),
-                static_cast<uint8_t>(source.row + movement_dir)
-            });
-        }
-    }
-    // try capture right
-    if ((source.col < 7)) {
-        std::optional<ChessEngineLib::Piece> diagonal_piece = board.grid().at(source.col+1).at(source.row + movement_dir);
-        if (diagonal_piece.has_value() && diagonal_piece.value().color != piece.color) {
-            dests.insert(ChessEngineLib::Square{
-                static_cast<uint8_t>(source.col + 1),
-                static_cast<uint8_t>(source.row + movement_dir)
-            });
-        }
+        dests |= ChessEngineLib::squareBit(board.getEnPassantSquare().value());
     }
+    dests |= ChessEngineLib::pawnAttacks(piece.color, ChessEngineLib::squareIndex(source)) & board.occupancy(enemy_color);
     return dests;
 }
 
-std::unordered_set<ChessEngineLib::Square> short_range_piece_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source,
-    std::vector<std::pair<std::uint8_t, std::uint8_t>> const& directions
+ChessEngineLib::Bitboard knight_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
-    ChessEngineLib::Piece piece = board.at(source).value();
-    assert(piece.type == ChessEngineLib::Piece::Type::King ||
-           piece.type == ChessEngineLib::Piece::Type::Knight);
-
-    std::unordered_set<ChessEngineLib::Square> dests {};
-    for (auto const& direction: directions) {
-        ChessEngineLib::Square dst = {
-            static_cast<std::uint8_t>(source.col + direction.first),
-            static_cast<std::uint8_t>(source.row + direction.second)
-        };
-        if (dst.col >= 8 || dst.row >= 8) {
-            continue;
-        }
-        if (board.at(dst).has_value() && board.at(dst).value().color == piece.color) {
-            continue;
-        }
-        dests.insert(std::move(dst));
-    }
-    return dests;
+    return ChessEngineLib::knightAttacks(ChessEngineLib::squareIndex(source)) & ~board.occupancy(color);
 }
 
-std::unordered_set<ChessEngineLib::Square> knight_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
-) {
-    return short_range_piece_destinations(board, source, {{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}});
-}
+struct CastlingPath {
+    // squares between king and rook
+    ChessEngineLib::Bitboard vacant;
+    // the king may not castle out of, through or into check
+    ChessEngineLib::Bitboard king_path;
+};
+
+// indexed by [color][side]
+constexpr std::array<std::array<CastlingPath, 2>, 2> castling_paths {{
+    {{
+        {ChessEngineLib::squareBit({1,7}) | ChessEngineLib::squareBit({2,7}) | ChessEngineLib::squareBit({3,7}),
+         ChessEngineLib::squareBit({4,7}) | ChessEngineLib::squareBit({3,7}) | ChessEngineLib::squareBit({2,7})},
+        {ChessEngineLib::squareBit({5,7}) | ChessEngineLib::squareBit({6,7}),
+         ChessEngineLib::squareBit({4,7}) | ChessEngineLib::squareBit({5,7}) | ChessEngineLib::squareBit({6,7})},
+    }},
+    {{
+        {ChessEngineLib::squareBit({1,0}) | ChessEngineLib::squareBit({2,0}) | ChessEngineLib::squareBit({3,0}),
+         ChessEngineLib::squareBit({4,0}) | ChessEngineLib::squareBit({3,0}) | ChessEngineLib::squareBit({2,0})},
+        {ChessEngineLib::squareBit({5,0}) | ChessEngineLib::squareBit({6,0}),
+         ChessEngineLib::squareBit({4,0}) | ChessEngineLib::squareBit({5,0}) | ChessEngineLib::squareBit({6,0})},
+    }},
+}};
+
 bool castling_allowed(
     ChessEngineLib::Board const& board,
     ChessEngineLib::Color color,
@@ -144,49 +159,635 @@ bool castling_allowed(
     if (!board.isCastlingAvailable(color, side)) {
         return false;
     }
-    std::unordered_set<ChessEngineLib::Square> vacant_squares_needed {};
-    if (color == ChessEngineLib::Color::Black && side == ChessEngineLib::Side::KingSide) {
-        vacant_squares_needed = {{5,7},{6,7}};
-    } else if (color == ChessEngineLib::Color::White && side == ChessEngineLib::Side::KingSide) {
-        vacant_squares_needed = {{5,0},{6,0}};
-    } else if (color == ChessEngineLib::Color::Black && side == ChessEngineLib::Side::QueenSide) {
-        vacant_squares_needed = {{1,7},{2,7},{3,7}};
-    } else if (color == ChessEngineLib::Color::White && side == ChessEngineLib::Side::QueenSide) {
-        vacant_squares_needed = {{1,0},{2,0},{3,0}};
-    } else {
-        assert(false);
+    CastlingPath const& path = castling_paths[color][side];
+    if (board.occupancy() & path.vacant) {
+        return false;
     }
-    for (ChessEngineLib::Square square: vacant_squares_needed) {
-        if (board.at(square).has_value()) {
+    ChessEngineLib::Color enemy_color = opposite_color(color);
+    ChessEngineLib::Bitboard king_path = path.king_path;
+    while (king_path) {
+        std::uint8_t square = ChessEngineLib::popLsb(king_path);
+        if (is_square_attacked(board, square, enemy_color, board.occupancy())) {
+            VLOG(9) << "castling not allowed because the king would cross attacked square " << ChessEngineLib::squareAt(square);
             return false;
         }
     }
     return true;
 }
 
-std::unordered_set<ChessEngineLib::Square> king_destinations(
-    ChessEngineLib::Board const& board, ChessEngineLib::Square source
+ChessEngineLib::Bitboard king_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Color color
 ) {
     VLOG(9) << "generating king destinations from source " << source;
     using namespace ChessEngineLib;
-    std::unordered_set<Square> dests =
-        short_range_piece_destinations(board, source, {{-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1}});
-    Piece const& piece = board.at(source).value();
+    Piece piece {Piece::Type::King, color};
+    Bitboard dests = kingAttacks(squareIndex(source)) & ~board.occupancy(piece.color);
     [[maybe_unused]] bool spawn_position = piece.color == Color::White ?
         source == Square({4,0}) : source == Square({4,7});
     if(castling_allowed(board, piece.color, ChessEngineLib::Side::KingSide)) {
         VLOG(9) << "adding kingside castle as a possible dest";
         assert(spawn_position);
-        dests.insert(Square({6,source.row}));
+        dests |= squareBit(Square({6,source.row}));
     }
     if(castling_allowed(board, piece.color, ChessEngineLib::Side::QueenSide)) {
         assert(spawn_position);
         VLOG(9) << "adding queenside castle as a possible dest";
-        dests.insert(Square({2,source.row}));
+        dests |= squareBit(Square({2,source.row}));
     }
     return dests;
 }
 
+// destinations of the piece on source regardless of whose turn it is, assumes there is a piece on source
+ChessEngineLib::Bitboard pseudo_legal_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source, ChessEngineLib::Piece::Type type
+) {
+    using ChessEngineLib::Piece;
+    ChessEngineLib::Color color = (board.occupancy(ChessEngineLib::Color::White) & ChessEngineLib::squareBit(source)) ?
+        ChessEngineLib::Color::White : ChessEngineLib::Color::Black;
+    switch (type) {
+        case Piece::Type::Pawn:
+            return pawn_destinations(board, source, color);
+        case Piece::Type::Rook:
+            return rook_destinations(board, source, color);
+        case Piece::Type::Queen:
+            return queen_destinations(board, source, color);
+        case Piece::Type::Bishop:
+            return bishop_destinations(board, source, color);
+        case Piece::Type::Knight:
+            return knight_destinations(board, source, color);
+        case Piece::Type::King:
+            return king_destinations(board, source, color);
+    }
+    return 0;
+}
+
+std::unordered_set<ChessEngineLib::Square> to_square_set(ChessEngineLib::Bitboard squares) {
+    std::unordered_set<ChessEngineLib::Square> result {};
+    while (squares) {
+        result.insert(ChessEngineLib::squareAt(ChessEngineLib::popLsb(squares)));
+    }
+    return result;
+}
+
+// what has to be known about a position to tell which pseudo-legal moves are legal without playing them
+struct LegalityInfo {
+    ChessEngineLib::Color color;
+    bool has_king;
+    std::uint8_t king_square;
+    ChessEngineLib::Bitboard checkers;
+    // pieces of color which are the only blocker between their king and an enemy slider
+    ChessEngineLib::Bitboard pinned;
+    // squares a piece other than the king has to move to, capturing the checker or blocking the check
+    ChessEngineLib::Bitboard check_mask;
+};
+
+LegalityInfo legality_info(ChessEngineLib::Board const& board) {
+    using namespace ChessEngineLib;
+    LegalityInfo info {};
+    info.color = board.getNextMoveColor();
+    info.check_mask = ~Bitboard {0};
+    Bitboard king = board.pieces(info.color, Piece::Type::King);
+    info.has_king = king != 0;
+    if (!info.has_king) {
+        return info;
+    }
+    Color enemy_color = opposite_color(info.color);
+    info.king_square = lsbIndex(king);
+    info.checkers = attackers_to(board, info.king_square, board.occupancy()) & board.occupancy(enemy_color);
+    if (info.checkers) {
+        std::uint8_t checker = lsbIndex(info.checkers);
+        info.check_mask = betweenSquares(info.king_square, checker) | squareBit(checker);
+    }
+
+    Bitboard enemy_queens = board.pieces(enemy_color, Piece::Type::Queen);
+    Bitboard snipers = (rookAttacks(info.king_square, 0) & (board.pieces(enemy_color, Piece::Type::Rook) | enemy_queens)) |
+        (bishopAttacks(info.king_square, 0) & (board.pieces(enemy_color, Piece::Type::Bishop) | enemy_queens));
+    while (snipers) {
+        Bitboard blockers = betweenSquares(info.king_square, popLsb(snipers)) & board.occupancy();
+        if (popCount(blockers) == 1) {
+            info.pinned |= blockers & board.occupancy(info.color);
+        }
+    }
+    return info;
+}
+
+// an en passant capture removes two pieces from the same rank, so it can expose the king even if neither is pinned
+bool is_en_passant_legal(ChessEngineLib::Board const& board, LegalityInfo const& info, ChessEngineLib::Square source) {
+    using namespace ChessEngineLib;
+    Square dst = board.getEnPassantSquare().value();
+    Bitboard captured = squareBit(Square {dst.col, source.row}) & board.pieces(opposite_color(info.color), Piece::Type::Pawn);
+    Bitboard occupancy = (board.occupancy() ^ squareBit(source) ^ captured) | squareBit(dst);
+    Bitboard attackers = attackers_to(board, info.king_square, occupancy) & board.occupancy(opposite_color(info.color));
+    return !(attackers & ~captured);
+}
+
+ChessEngineLib::Bitboard legal_destinations(
+    ChessEngineLib::Board const& board, ChessEngineLib::Square source,
+    ChessEngineLib::Piece::Type type, LegalityInfo const& info
+) {
+    using namespace ChessEngineLib;
+    Bitboard dsts = pseudo_legal_destinations(board, source, type);
+    VLOG(2) << "found " << popCount(dsts) << " pseudo-legal moves from source square " << source;
+    if (!info.has_king) {
+        return dsts;
+    }
+    if (type == Piece::Type::King) {
+        // castling already checked the squares the king crosses, every other step must land on a safe square
+        Color enemy_color = opposite_color(info.color);
+        Bitboard occupancy_without_king = board.occupancy() ^ squareBit(source);
+        Bitboard steps = dsts & kingAttacks(squareIndex(source));
+        while (steps) {
+            std::uint8_t dst = popLsb(steps);
+            if (is_square_attacked(board, dst, enemy_color, occupancy_without_king)) {
+                dsts &= ~squareBit(dst);
+            }
+        }
+        return dsts;
+    }
+    if (popCount(info.checkers) > 1) {
+        return 0;
+    }
+    Bitboard en_passant = 0;
+    if (type == Piece::Type::Pawn && board.getEnPassantSquare().has_value()) {
+        en_passant = dsts & squareBit(board.getEnPassantSquare().value());
+        dsts &= ~en_passant;
+    }
+    dsts &= info.check_mask;
+    if (info.pinned & squareBit(source)) {
+        dsts &= lineThrough(info.king_square, squareIndex(source));
+    }
+    if (en_passant && is_en_passant_legal(board, info, source)) {
+        dsts |= en_passant;
+    }
+    VLOG(2) << "found " << popCount(dsts) << " fully legal moves from source " << source;
+    return dsts;
+}
+
+// whether a pseudo-legal move leaves the king of the side to move safe, without making the move
+bool is_pseudo_legal_move_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
+    using namespace ChessEngineLib;
+    Color color = board.getNextMoveColor();
+    Bitboard king = board.pieces(color, Piece::Type::King);
+    if (!king) {
+        return true;
+    }
+    Color enemy_color = opposite_color(color);
+    Bitboard from = squareBit(move.fromSquare);
+    Bitboard to = squareBit(move.toSquare);
+    if (king & from) {
+        // castling already checked the squares the king crosses
+        if (std::abs(move.toSquare.col - move.fromSquare.col) == 2) {
+            return true;
+        }
+        return !is_square_attacked(board, squareIndex(move.toSquare), enemy_color, board.occupancy() ^ from);
+    }
+    LegalityInfo info {};
+    info.color = color;
+    info.king_square = lsbIndex(king);
+    bool is_en_passant = (board.pieces(color, Piece::Type::Pawn) & from) &&
+        board.getEnPassantSquare() == move.toSquare && move.fromSquare.col != move.toSquare.col;
+    if (is_en_passant) {
+        return is_en_passant_legal(board, info, move.fromSquare);
+    }
+    // whatever stands on the destination is captured and so no longer attacks the king
+    Bitboard occupancy = (board.occupancy() ^ from) | to;
+    Bitboard attackers = attackers_to(board, info.king_square, occupancy) & board.occupancy(enemy_color) & ~to;
+    return !attackers;
+}
+
+void add_moves(
+    ChessEngineLib::MoveList& moves, ChessEngineLib::Board const& board, ChessEngineLib::Piece::Type type,
+    ChessEngineLib::Square source, ChessEngineLib::Bitboard dests
+) {
+    using namespace ChessEngineLib;
+    using Kind = PackedMove::Kind;
+    std::uint8_t from = squareIndex(source);
+    while (dests) {
+        std::uint8_t to = popLsb(dests);
+        Square dst = squareAt(to);
+        if (type == Piece::Type::Pawn && (dst.row == 7 || dst.row == 0)) {
+            moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Queen));
+            moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Rook));
+            moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Bishop));
+            moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Knight));
+        } else if (type == Piece::Type::Pawn && board.getEnPassantSquare() == dst && dst.col != source.col) {
+            moves.push_back(PackedMove(from, to, Kind::EnPassant));
+        } else if (type == Piece::Type::King && std::abs(dst.col - source.col) == 2) {
+            moves.push_back(PackedMove(from, to, Kind::Castle));
+        } else {
+            moves.push_back(PackedMove(from, to));
+        }
+    }
+}
+
+constexpr ChessEngineLib::Bitboard promotion_ranks = 0xFF000000000000FFull;
+
+constexpr ChessEngineLib::Bitboard file_a = 0x0101010101010101ull;
+constexpr ChessEngineLib::Bitboard file_h = 0x8080808080808080ull;
+
+// shifts every square by offset, towards the eighth rank if offset is positive
+template <int Offset>
+constexpr ChessEngineLib::Bitboard shift(ChessEngineLib::Bitboard b) {
+    if constexpr (Offset > 0) {
+        return b << Offset;
+    } else {
+        return b >> -Offset;
+    }
+}
+
+// pawn moves to dests which were made from the square Offset behind each of them
+template <int Offset>
+void add_pawn_moves(ChessEngineLib::MoveList& moves, ChessEngineLib::Bitboard dests) {
+    using namespace ChessEngineLib;
+    using Kind = PackedMove::Kind;
+    Bitboard promotions = dests & promotion_ranks;
+    dests &= ~promotion_ranks;
+    while (dests) {
+        std::uint8_t to = popLsb(dests);
+        moves.push_back(PackedMove(static_cast<std::uint8_t>(to - Offset), to));
+    }
+    while (promotions) {
+        std::uint8_t to = popLsb(promotions);
+        std::uint8_t from = static_cast<std::uint8_t>(to - Offset);
+        moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Queen));
+        moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Rook));
+        moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Bishop));
+        moves.push_back(PackedMove(from, to, Kind::Promotion, Piece::Type::Knight));
+    }
+}
+
+void add_piece_moves(ChessEngineLib::MoveList& moves, std::uint8_t from, ChessEngineLib::Bitboard dests) {
+    while (dests) {
+        moves.push_back(ChessEngineLib::PackedMove(from, ChessEngineLib::popLsb(dests)));
+    }
+}
+
+// pushes, double pushes and captures of all pawns at once, en passant is left to the caller
+template <ChessEngineLib::Color Us>
+void add_pawn_set_moves(
+    ChessEngineLib::Board const& board, ChessEngineLib::MoveList& moves,
+    ChessEngineLib::Bitboard pawns, ChessEngineLib::Bitboard allowed
+) {
+    using namespace ChessEngineLib;
+    constexpr Color them = Us == Color::White ? Color::Black : Color::White;
+    constexpr int up = Us == Color::White ? 8 : -8;
+    // where a single push from the starting rank lands
+    constexpr Bitboard double_push_rank = Us == Color::White ? 0x0000000000FF0000ull : 0x0000FF0000000000ull;
+    Bitboard empty = ~board.occupancy();
+    Bitboard single = shift<up>(pawns) & empty;
+    Bitboard double_push = shift<up>(single & double_push_rank) & empty;
+    add_pawn_moves<up>(moves, single & allowed);
+    add_pawn_moves<2 * up>(moves, double_push & allowed);
+    add_pawn_moves<up - 1>(moves, shift<up - 1>(pawns & ~file_a) & board.occupancy(them) & allowed);
+    add_pawn_moves<up + 1>(moves, shift<up + 1>(pawns & ~file_h) & board.occupancy(them) & allowed);
+}
+
+// Us is the side to move. Fixing it at compile time lets pawn directions, promotion and castling squares
+// and the enemy color fold into constants instead of being looked up for every piece.
+// Legal moves whose destination is in targets, or in pawn_targets for pawns.
+template <ChessEngineLib::Color Us>
+void generate_legal_moves_for(
+    ChessEngineLib::Board const& board, ChessEngineLib::MoveList& moves,
+    ChessEngineLib::Bitboard targets, ChessEngineLib::Bitboard pawn_targets
+) {
+    using namespace ChessEngineLib;
+    constexpr Color them = Us == Color::White ? Color::Black : Color::White;
+    constexpr std::uint8_t home_row = Us == Color::White ? 0 : 7;
+    LegalityInfo info = legality_info(board);
+    Bitboard const own = board.occupancy(Us);
+
+    Bitboard king = board.pieces(Us, Piece::Type::King);
+    if (king) {
+        std::uint8_t from = lsbIndex(king);
+        Bitboard occupancy_without_king = board.occupancy() ^ king;
+        Bitboard steps = kingAttacks(from) & ~own & targets;
+        while (steps) {
+            std::uint8_t to = popLsb(steps);
+            if (!is_square_attacked(board, to, them, occupancy_without_king)) {
+                moves.push_back(PackedMove(from, to));
+            }
+        }
+        if ((targets & squareBit(home_row * 8 + 6)) && castling_allowed(board, Us, Side::KingSide)) {
+            moves.push_back(PackedMove(from, home_row * 8 + 6, PackedMove::Kind::Castle));
+        }
+        if ((targets & squareBit(home_row * 8 + 2)) && castling_allowed(board, Us, Side::QueenSide)) {
+            moves.push_back(PackedMove(from, home_row * 8 + 2, PackedMove::Kind::Castle));
+        }
+    }
+    if (popCount(info.checkers) > 1) {
+        return;
+    }
+
+    Bitboard const allowed = info.check_mask & ~own;
+    Bitboard pawns = board.pieces(Us, Piece::Type::Pawn);
+    add_pawn_set_moves<Us>(board, moves, pawns & ~info.pinned, allowed & pawn_targets);
+    Bitboard pinned_pawns = pawns & info.pinned;
+    while (pinned_pawns) {
+        std::uint8_t from = popLsb(pinned_pawns);
+        add_pawn_set_moves<Us>(board, moves, squareBit(from), allowed & pawn_targets & lineThrough(info.king_square, from));
+    }
+    if (board.getEnPassantSquare().has_value() && (pawn_targets & squareBit(board.getEnPassantSquare().value()))) {
+        std::uint8_t to = squareIndex(board.getEnPassantSquare().value());
+        Bitboard capturers = pawnAttacks(them, to) & pawns;
+        while (capturers) {
+            std::uint8_t from = popLsb(capturers);
+            if (!info.has_king || is_en_passant_legal(board, info, squareAt(from))) {
+                moves.push_back(PackedMove(from, to, PackedMove::Kind::EnPassant));
+            }
+        }
+    }
+
+    // a pinned knight can never stay on the line to its king
+    Bitboard knights = board.pieces(Us, Piece::Type::Knight) & ~info.pinned;
+    while (knights) {
+        std::uint8_t from = popLsb(knights);
+        add_piece_moves(moves, from, knightAttacks(from) & allowed & targets);
+    }
+    Bitboard const occupancy = board.occupancy();
+    auto pin_line = [&info](std::uint8_t from) {
+        return (info.pinned & squareBit(from)) ? lineThrough(info.king_square, from) : ~Bitboard {0};
+    };
+    Bitboard bishops = board.pieces(Us, Piece::Type::Bishop);
+    while (bishops) {
+        std::uint8_t from = popLsb(bishops);
+        add_piece_moves(moves, from, bishopAttacks(from, occupancy) & allowed & targets & pin_line(from));
+    }
+    Bitboard rooks = board.pieces(Us, Piece::Type::Rook);
+    while (rooks) {
+        std::uint8_t from = popLsb(rooks);
+        add_piece_moves(moves, from, rookAttacks(from, occupancy) & allowed & targets & pin_line(from));
+    }
+    Bitboard queens = board.pieces(Us, Piece::Type::Queen);
+    while (queens) {
+        std::uint8_t from = popLsb(queens);
+        add_piece_moves(moves, from, queenAttacks(from, occupancy) & allowed & targets & pin_line(from));
+    }
+}
+
+void generate_legal_moves(
+    ChessEngineLib::Board const& board, ChessEngineLib::MoveList& moves,
+    ChessEngineLib::Bitboard targets, ChessEngineLib::Bitboard pawn_targets
+) {
+    if (board.getNextMoveColor() == ChessEngineLib::Color::White) {
+        generate_legal_moves_for<ChessEngineLib::Color::White>(board, moves, targets, pawn_targets);
+    } else {
+        generate_legal_moves_for<ChessEngineLib::Color::Black>(board, moves, targets, pawn_targets);
+    }
+}
+
+// what has to be known about a position to tell which moves give check without playing them
+struct CheckInfo {
+    bool has_enemy_king;
+    std::uint8_t enemy_king_square;
+    // squares from which a piece of each type would attack the enemy king, indexed by Piece::Type
+    std::array<ChessEngineLib::Bitboard, 6> check_squares;
+    // pieces of the side to move which are the only blocker between the enemy king and one of our sliders
+    ChessEngineLib::Bitboard discovered_check_candidates;
+};
+
+CheckInfo check_info(ChessEngineLib::Board const& board) {
+    using namespace ChessEngineLib;
+    Color color = board.getNextMoveColor();
+    Color enemy_color = opposite_color(color);
+    CheckInfo info {};
+    Bitboard enemy_king = board.pieces(enemy_color, Piece::Type::King);
+    info.has_enemy_king = enemy_king != 0;
+    if (!info.has_enemy_king) {
+        return info;
+    }
+    std::uint8_t king_square = lsbIndex(enemy_king);
+    info.enemy_king_square = king_square;
+    Bitboard occupancy = board.occupancy();
+    info.check_squares[Piece::Type::Pawn] = pawnAttacks(enemy_color, king_square);
+    info.check_squares[Piece::Type::Knight] = knightAttacks(king_square);
+    info.check_squares[Piece::Type::Bishop] = bishopAttacks(king_square, occupancy);
+    info.check_squares[Piece::Type::Rook] = rookAttacks(king_square, occupancy);
+    info.check_squares[Piece::Type::Queen] = info.check_squares[Piece::Type::Bishop] | info.check_squares[Piece::Type::Rook];
+    info.check_squares[Piece::Type::King] = 0;
+
+    Bitboard queens = board.pieces(color, Piece::Type::Queen);
+    Bitboard snipers = (rookAttacks(king_square, 0) & (board.pieces(color, Piece::Type::Rook) | queens)) |
+        (bishopAttacks(king_square, 0) & (board.pieces(color, Piece::Type::Bishop) | queens));
+    while (snipers) {
+        Bitboard blockers = betweenSquares(king_square, popLsb(snipers)) & occupancy;
+        if (popCount(blockers) == 1) {
+            info.discovered_check_candidates |= blockers & board.occupancy(color);
+        }
+    }
+    return info;
+}
+
+// whether the side to move gives check by playing move, which has to be legal in board
+bool gives_check(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move, CheckInfo const& info) {
+    using namespace ChessEngineLib;
+    if (!info.has_enemy_king) {
+        return false;
+    }
+    Color color = board.getNextMoveColor();
+    std::uint8_t from = squareIndex(move.fromSquare);
+    std::uint8_t to = squareIndex(move.toSquare);
+    std::uint8_t king_square = info.enemy_king_square;
+    Piece::Type type = board.typeAt(color, from).value();
+
+    // direct check, a promotion is handled below since the pawn leaving can open the line to the king
+    if (!move.promotionTo.has_value() && (info.check_squares[type] & squareBit(to))) {
+        return true;
+    }
+    // discovered check, unless the piece stays on the line between the slider and the king
+    if ((info.discovered_check_candidates & squareBit(from)) && !(lineThrough(king_square, from) & squareBit(to))) {
+        return true;
+    }
+
+    Bitboard occupancy_after = (board.occupancy() ^ squareBit(from)) | squareBit(to);
+    if (move.promotionTo.has_value()) {
+        switch (move.promotionTo.value()) {
+            case Piece::Type::Knight:
+                return knightAttacks(to) & squareBit(king_square);
+            case Piece::Type::Bishop:
+                return bishopAttacks(to, occupancy_after) & squareBit(king_square);
+            case Piece::Type::Rook:
+                return rookAttacks(to, occupancy_after) & squareBit(king_square);
+            case Piece::Type::Queen:
+                return queenAttacks(to, occupancy_after) & squareBit(king_square);
+            default:
+                return false;
+        }
+    }
+    if (type == Piece::Type::Pawn && board.getEnPassantSquare() == move.toSquare && move.fromSquare.col != move.toSquare.col) {
+        // two pawns leave the rank at once, which neither of the checks above can see
+        Bitboard captured = squareBit(Square {move.toSquare.col, move.fromSquare.row});
+        occupancy_after ^= captured;
+        Bitboard queens = board.pieces(color, Piece::Type::Queen);
+        return (rookAttacks(king_square, occupancy_after) & (board.pieces(color, Piece::Type::Rook) | queens)) ||
+            (bishopAttacks(king_square, occupancy_after) & (board.pieces(color, Piece::Type::Bishop) | queens));
+    }
+    if (type == Piece::Type::King && std::abs(move.toSquare.col - move.fromSquare.col) == 2) {
+        // only the rook can check, from the square the king passed over
+        std::uint8_t rook_from = move.toSquare.col == 6 ? to + 1 : to - 2;
+        std::uint8_t rook_to = move.toSquare.col == 6 ? to - 1 : to + 1;
+        Bitboard occupancy_after_castling = (occupancy_after ^ squareBit(rook_from)) | squareBit(rook_to);
+        return rookAttacks(rook_to, occupancy_after_castling) & squareBit(king_square);
+    }
+    return false;
+}
+
+// stops at the first piece with a legal destination instead of generating every move
+bool has_any_legal_move(ChessEngineLib::Board const& board) {
+    using namespace ChessEngineLib;
+    LegalityInfo info = legality_info(board);
+    Color color = info.color;
+    // the king is the only piece which may move in double check and usually has a safe square otherwise
+    std::optional<Square> king = board.kingSquare(color);
+    if (king.has_value() && legal_destinations(board, king.value(), Piece::Type::King, info)) {
+        return true;
+    }
+    if (info.has_king && popCount(info.checkers) > 1) {
+        return false;
+    }
+    // more mobile pieces first, they are the most likely to have somewhere to go
+    constexpr std::array<Piece::Type, 5> order = {
+        Piece::Type::Queen, Piece::Type::Rook, Piece::Type::Bishop, Piece::Type::Knight, Piece::Type::Pawn
+    };
+    for (Piece::Type type: order) {
+        Bitboard sources = board.pieces(color, type);
+        while (sources) {
+            if (legal_destinations(board, squareAt(popLsb(sources)), type, info)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::optional<ChessEngineLib::Piece::Type> san_piece_type(char c) {
+    using ChessEngineLib::Piece;
+    switch (c) {
+        case 'K':
+            return Piece::Type::King;
+        case 'Q':
+            return Piece::Type::Queen;
+        case 'R':
+            return Piece::Type::Rook;
+        case 'B':
+            return Piece::Type::Bishop;
+        case 'N':
+            return Piece::Type::Knight;
+        default:
+            return std::nullopt;
+    }
+}
+
+ChessEngineLib::Bitboard piece_sources_on_empty_board(ChessEngineLib::Piece::Type type, std::uint8_t square) {
+    using namespace ChessEngineLib;
+    switch (type) {
+        case Piece::Type::Knight:
+            return knightAttacks(square);
+        case Piece::Type::Bishop:
+            return bishopAttacks(square, 0);
+        case Piece::Type::Rook:
+            return rookAttacks(square, 0);
+        case Piece::Type::Queen:
+            return queenAttacks(square, 0);
+        case Piece::Type::King:
+            return kingAttacks(square);
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+// pieces of color and type, other than pawns, which can move to the square if legality is ignored
+ChessEngineLib::Bitboard piece_sources(
+    ChessEngineLib::Board const& board, ChessEngineLib::Color color, ChessEngineLib::Piece::Type type, std::uint8_t to
+) {
+    using namespace ChessEngineLib;
+    Bitboard pieces = board.pieces(color, type);
+    switch (type) {
+        case Piece::Type::Knight:
+            return knightAttacks(to) & pieces;
+        case Piece::Type::Bishop:
+            return bishopAttacks(to, board.occupancy()) & pieces;
+        case Piece::Type::Rook:
+            return rookAttacks(to, board.occupancy()) & pieces;
+        case Piece::Type::Queen:
+            return queenAttacks(to, board.occupancy()) & pieces;
+        case Piece::Type::King:
+            return kingAttacks(to) & pieces;
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+// A reversible move of a piece between two squares, stored under the hash difference it makes. Moving the
+// piece either way between the squares and handing the move over changes the hash by the same key.
+struct CuckooEntry {
+    std::uint64_t key {0};
+    std::uint8_t piece_index {0};
+    std::uint8_t a {0};
+    std::uint8_t b {0};
+};
+
+constexpr std::size_t cuckoo_size = 8192;
+
+std::size_t cuckoo_h1(std::uint64_t key) {
+    return key & (cuckoo_size - 1);
+}
+
+std::size_t cuckoo_h2(std::uint64_t key) {
+    return (key >> 16) & (cuckoo_size - 1);
+}
+
+// every move of a piece other than a pawn on an empty board, each in one of its two cuckoo slots
+std::array<CuckooEntry, cuckoo_size> make_cuckoo_table() {
+    using namespace ChessEngineLib;
+    std::array<CuckooEntry, cuckoo_size> table {};
+    for (std::uint8_t piece_index = 0; piece_index < 12; piece_index++) {
+        Piece::Type type = static_cast<Piece::Type>(piece_index % 6);
+        if (type == Piece::Type::Pawn) {
+            continue;
+        }
+        Color color = static_cast<Color>(piece_index / 6);
+        for (std::uint8_t a = 0; a < 64; a++) {
+            Bitboard reachable = piece_sources_on_empty_board(type, a) & ~((squareBit(a) << 1) - 1);
+            while (reachable) {
+                std::uint8_t b = popLsb(reachable);
+                auto const& keys = zobristKeys.pieces[color * 6 + type];
+                CuckooEntry entry {keys[a] ^ keys[b] ^ zobristKeys.whiteToMove, piece_index, a, b};
+                std::size_t slot = cuckoo_h1(entry.key);
+                // kick out whatever is in the slot and move it to its other one, until a slot was empty
+                while (true) {
+                    std::swap(table[slot], entry);
+                    if (entry.key == 0) {
+                        break;
+                    }
+                    slot = slot == cuckoo_h1(entry.key) ? cuckoo_h2(entry.key) : cuckoo_h1(entry.key);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+std::array<CuckooEntry, cuckoo_size> const& cuckoo_table() {
+    // built on first use since the sliding attack tables are filled during static initialization
+    static std::array<CuckooEntry, cuckoo_size> const table = make_cuckoo_table();
+    return table;
+}
+
+std::optional<ChessEngineLib::Move> parse_san_castling(ChessEngineLib::Board const& board, ChessEngineLib::Side side) {
+    using namespace ChessEngineLib;
+    std::uint8_t row = board.getNextMoveColor() == Color::White ? 0 : 7;
+    Move move {{4, row}, {static_cast<std::uint8_t>(side == Side::KingSide ? 6 : 2), row}};
+    if (!(board.pieces(board.getNextMoveColor(), Piece::Type::King) & squareBit(move.fromSquare))) {
+        return std::nullopt;
+    }
+    if (!castling_allowed(board, board.getNextMoveColor(), side)) {
+        return std::nullopt;
+    }
+    return move;
+}
+
 bool is_pawn_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
     assert(move.fromSquare.row != 0 && move.fromSquare.row != 7);
 
@@ -210,7 +811,8 @@ bool is_pawn_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLi
             }
             return true;
         } else if (move.toSquare.row == expected_double_move_row) {
-            return spawn_position && !board.grid().at(move.fromSquare.col).at(expected_single_move_row).has_value();
+            return spawn_position &&
+                !(board.occupancy() & ChessEngineLib::squareBit(ChessEngineLib::Square {move.fromSquare.col, expected_single_move_row}));
         } else {
             VLOG(3) << "illegal pawn move because pawn dont move like that: " << move;
             return false;
@@ -225,106 +827,43 @@ bool is_pawn_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLi
 }
 
 bool is_rook_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
-    std::int8_t direction_col = move.toSquare.col - move.fromSquare.col;
-    std::int8_t direction_row = move.toSquare.row - move.fromSquare.row;
-    direction_col = std::clamp<std::int8_t>(direction_col, -1, 1);
-    direction_row = std::clamp<std::int8_t>(direction_row, -1, 1);
-    if ((direction_row != 0) && (direction_col != 0)) {
-        VLOG(3) << "illegal move because rook dont move in the direction (" << +direction_col << ", " << +direction_row << ")";
+    using namespace ChessEngineLib;
+    if (!(rookAttacks(squareIndex(move.fromSquare), board.occupancy()) & squareBit(move.toSquare))) {
+        VLOG(3) << "illegal move because rook dont move like that or there is a piece in the way: " << move;
         return false;
     }
-    VLOG(5) << "moving in direction (" << +direction_col << ", " << +direction_row << ")";
-    VLOG(5) << "move = " << move;
-    for (
-        std::uint8_t col = move.fromSquare.col + direction_col, row = move.fromSquare.row + direction_row;
-        (col != move.toSquare.col) || (row != move.toSquare.row);
-        col += direction_col, row += direction_row
-    ) {
-        VLOG(5) << "checking contents at (" << +col << ", " << +row << ")";
-        assert(col < 8);
-        assert(row < 8);
-        if (board.grid().at(col).at(row).has_value()) {
-            VLOG(3) << "illegal move because there is a piece in the way at (" << col << ", " << row << ")";
-            return false;
-        }
-    }
     return true;
 }
 
 bool is_queen_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
-    std::int8_t direction_col = move.toSquare.col - move.fromSquare.col;
-    std::int8_t direction_row = move.toSquare.row - move.fromSquare.row;
-    if ((std::abs(direction_col) != std::abs(direction_row)) &&
-        (direction_row != 0) && (direction_col != 0)
-    ) {
-        VLOG(3) << "illegal move because queen dont move in the direction (" << +direction_col << ", " << +direction_row << ")";
+    using namespace ChessEngineLib;
+    if (!(queenAttacks(squareIndex(move.fromSquare), board.occupancy()) & squareBit(move.toSquare))) {
+        VLOG(3) << "illegal move because queen dont move like that or there is a piece in the way: " << move;
         return false;
     }
-    direction_col = std::clamp<std::int8_t>(direction_col, -1, 1);
-    direction_row = std::clamp<std::int8_t>(direction_row, -1, 1);
-    for (
-        std::uint8_t col = move.fromSquare.col + direction_col, row = move.fromSquare.row + direction_row;
-        (col != move.toSquare.col) || (row != move.toSquare.row);
-        col += direction_col, row += direction_row
-    ) {
-        VLOG(5) << "checking contents at (" << +col << ", " << +row << ")";
-        assert(col < 8);
-        assert(row < 8);
-        if (board.grid().at(col).at(row).has_value()) {
-            VLOG(3) << "illegal move because there is a piece in the way at (" << col << ", " << row << ")";
-            return false;
-        }
-    }
     return true;
 }
 
 bool is_bishop_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
-    std::int8_t direction_col = move.toSquare.col - move.fromSquare.col;
-    std::int8_t direction_row = move.toSquare.row - move.fromSquare.row;
-    if (std::abs(move.toSquare.col - move.fromSquare.col) != std::abs(move.toSquare.row - move.fromSquare.row)) {
-        VLOG(3) << "illegal move because bishop dont move in the direction (" << +direction_col << ", " << +direction_row << ")";
+    using namespace ChessEngineLib;
+    if (!(bishopAttacks(squareIndex(move.fromSquare), board.occupancy()) & squareBit(move.toSquare))) {
+        VLOG(3) << "illegal move because bishop dont move like that or there is a piece in the way: " << move;
         return false;
     }
-    direction_col = std::clamp<std::int8_t>(direction_col, -1, 1);
-    direction_row = std::clamp<std::int8_t>(direction_row, -1, 1);
-    for (
-        std::uint8_t col = move.fromSquare.col + direction_col, row = move.fromSquare.row + direction_row;
-        (col != move.toSquare.col) || (row != move.toSquare.row);
-        col += direction_col, row += direction_row
-    ) {
-        assert(col < 8);
-        assert(row < 8);
-        VLOG(5) << "checking contents at (" << +col << ", " << +row << ")";
-        if (board.grid().at(col).at(row).has_value()) {
-            VLOG(3) << "illegal move because there is a piece in the way at (" << col << ", " << row << ")";
-            return false;
-        }
-    }
     return true;
 }
 
 bool is_knight_move_pseudo_legal(ChessEngineLib::Board const&, ChessEngineLib::Move const& move) {
-    std::pair<std::int8_t, std::int8_t> direction = {
-        move.toSquare.col - move.fromSquare.col,
-        move.toSquare.row - move.fromSquare.row
-    };
-    if (std::abs(direction.first) == 2 && std::abs(direction.second) == 1) {
+    if (ChessEngineLib::knightAttacks(ChessEngineLib::squareIndex(move.fromSquare)) & ChessEngineLib::squareBit(move.toSquare)) {
         return true;
     }
-    if (std::abs(direction.first) == 1 && std::abs(direction.second) == 2) {
-        return true;
-    }
-    VLOG(3) << "illegal move because knight dont move in the direction (" << +direction.first << ", " << +direction.second << ")";
+    VLOG(3) << "illegal move because knight cant reach " << move.toSquare << " from " << move.fromSquare;
     return false;
 }
 
 bool is_king_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLib::Move const& move) {
-    std::pair<std::int8_t, std::int8_t> direction = {
-        move.toSquare.col - move.fromSquare.col,
-        move.toSquare.row - move.fromSquare.row
-    };
     // normal move
-    if (std::abs(direction.first) <= 1 && std::abs(direction.second) <= 1) {
+    if (ChessEngineLib::kingAttacks(ChessEngineLib::squareIndex(move.fromSquare)) & ChessEngineLib::squareBit(move.toSquare)) {
         return true;
     }
 
@@ -351,60 +890,61 @@ bool is_king_move_pseudo_legal(ChessEngineLib::Board const& board, ChessEngineLi
 
 namespace ChessEngineLib {
 
-bool validateFen(std::string const& fen) {
+bool validateFen(std::string_view fen) {
     std::optional<Board> board = Board::fromFen(fen);
     return board.has_value();
 }
 
 std::unordered_set<Square> generateLegalDestinations(Board const& board, Square source) {
-    VLOG(2) << "generating pseudo-legal moves for source " << source;
-    std::unordered_set<Square> dsts = generatePseudoLegalDestinations(board, source);
-    VLOG(2) << "found " << dsts.size() << " pseudo-legal moves from source square " << source;
-    for (auto it = dsts.begin(); it != dsts.end();) {
-        Square dst = *it;
-        Board board_copy = board;
-        Move move = Move(source, dst);
-        board_copy.forceMakeMove(move);
-        VLOG(4) << "check if king capture possible after theoretical move " << move;
-        if (isKingCapturePossibleNextMove(board_copy)) {
-            VLOG(4) << "determined that king capture possible for move " << move;
-            it = dsts.erase(it);
-        } else {
-            VLOG(4) << "determined that move " << move << " is legal";
-            it++;
-        }
+    VLOG(2) << "generating legal moves for source " << source;
+    std::optional<Piece> piece = board.at(source);
+    if (!piece.has_value() || piece.value().color != board.getNextMoveColor()) {
+        return {};
     }
-    VLOG(2) << "found " << dsts.size() << " fully legal moves from source " << source;
-    return dsts;
+    return to_square_set(legal_destinations(board, source, piece.value().type, legality_info(board)));
 }
 
 std::unordered_set<Square> generatePseudoLegalDestinations(Board const& board, Square source) {
-    std::optional<Piece> const& piece = board.grid().at(source.col).at(source.row);
+    std::optional<Piece> piece = board.at(source);
     if (!piece.has_value()) {
         return {};
     }
     if (piece.value().color != board.getNextMoveColor()) {
         return {};
     }
-    switch (piece.value().type) {
-        case Piece::Type::Pawn:
-            return pawn_destinations(board, source);
-        case Piece::Type::Rook:
-            return rook_destinations(board, source);
-        case Piece::Type::Queen:
-            return queen_destinations(board, source);
-        case Piece::Type::Bishop:
-            return bishop_destinations(board, source);
-        case Piece::Type::Knight:
-            return knight_destinations(board, source);
-        case Piece::Type::King:
-            return king_destinations(board, source);
+    return to_square_set(pseudo_legal_destinations(board, source, piece.value().type));
+}
+
+void generatePseudoLegalMoves(Board const& board, MoveList& moves) {
+    Color color = board.getNextMoveColor();
+    for (std::uint8_t type=Piece::Type::Pawn; type <= Piece::Type::King; type++) {
+        Bitboard sources = board.pieces(color, static_cast<Piece::Type>(type));
+        while (sources) {
+            Square source = squareAt(popLsb(sources));
+            Bitboard dsts = pseudo_legal_destinations(board, source, static_cast<Piece::Type>(type));
+            add_moves(moves, board, static_cast<Piece::Type>(type), source, dsts);
+        }
     }
-    return {};
+}
+
+void generateLegalMoves(Board const& board, MoveList& moves) {
+    generate_legal_moves(board, moves, ~Bitboard {0}, ~Bitboard {0});
+}
+
+void generateLegalCaptures(Board const& board, MoveList& moves) {
+    Bitboard enemy = board.occupancy(opposite_color(board.getNextMoveColor()));
+    Bitboard en_passant = board.getEnPassantSquare().has_value() ? squareBit(board.getEnPassantSquare().value()) : 0;
+    generate_legal_moves(board, moves, enemy, enemy | en_passant | promotion_ranks);
+}
+
+void generateLegalQuietMoves(Board const& board, MoveList& moves) {
+    Bitboard empty = ~board.occupancy();
+    Bitboard en_passant = board.getEnPassantSquare().has_value() ? squareBit(board.getEnPassantSquare().value()) : 0;
+    generate_legal_moves(board, moves, empty, empty & ~en_passant & ~promotion_ranks);
 }
 
 bool isMovePseudoLegal(Board const& board, Move const& move) {
-    std::optional<Piece> const& piece = board.at(move.fromSquare);
+    std::optional<Piece> piece = board.at(move.fromSquare);
     if (!piece.has_value()) {
         VLOG(3) << "illegal move because no piece on source";
         return false;
@@ -454,36 +994,207 @@ bool makeMove(Board& board, Move const& move) {
     if(!isMovePseudoLegal(board, move)) {
         return false;
     }
-    Board board_before_move = board;
-    board.forceMakeMove(move);
-    if (isKingCapturePossibleNextMove(board)) {
+    if (!is_pseudo_legal_move_legal(board, move)) {
         VLOG(2) << "illegal move because king would die immediately";
-        board = board_before_move;
         return false;
     }
+    board.forceMakeMove(move);
     return true;
 }
 
-bool isKingCapturePossibleNextMove(ChessEngineLib::Board const& board) {
-    VLOG(4) << "trying to check if king capture is possible next move by generating pseudolegal destinations in theoretical position";
-    for (std::uint8_t col=0; col<8; col++) {
-        for (std::uint8_t row=0; row<8; row++) {
-            std::unordered_set<Square> res = generatePseudoLegalDestinations(board, Square({col, row}));
-            if (!res.empty()) {
-                VLOG(7) << "found " << res.size() << " pseudo legal-moves from square at (" << +col << ", " << +row << ")";
-            }
-            for (Square const& sqr: res) {
-                if (board.at(sqr).has_value() && board.at(sqr).value().type == Piece::Type::King) {
-                    VLOG(4) << "determined that king capture is possible in theoretical position";
-                    return true;
+bool hasAnyLegalMove(Board const& board) {
+    return has_any_legal_move(board);
+}
+
+bool givesCheck(Board const& board, Move const& move) {
+    return gives_check(board, move, check_info(board));
+}
+
+std::optional<Move> parseSan(Board const& board, std::string_view san) {
+    VLOG(4) << "parsing san " << san;
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    if (san == "O-O" || san == "0-0") {
+        return parse_san_castling(board, Side::KingSide);
+    }
+    if (san == "O-O-O" || san == "0-0-0") {
+        return parse_san_castling(board, Side::QueenSide);
+    }
+
+    std::optional<Piece::Type> promotion_to = std::nullopt;
+    if (!san.empty() && (promotion_to = san_piece_type(san.back())).has_value()) {
+        san.remove_suffix(1);
+        if (!san.empty() && san.back() == '=') {
+            san.remove_suffix(1);
+        }
+        if (promotion_to == Piece::Type::King) {
+            return std::nullopt;
+        }
+    }
+    if (san.size() < 2) {
+        return std::nullopt;
+    }
+    char file = san[san.size() - 2];
+    char rank = san[san.size() - 1];
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') {
+        VLOG(3) << "san doesnt end in a square";
+        return std::nullopt;
+    }
+    std::uint8_t to = static_cast<std::uint8_t>((rank - '1') * 8 + (file - 'a'));
+    san.remove_suffix(2);
+
+    Piece::Type type = Piece::Type::Pawn;
+    if (!san.empty() && san_piece_type(san.front()).has_value()) {
+        type = san_piece_type(san.front()).value();
+        san.remove_prefix(1);
+    }
+    bool is_capture = !san.empty() && san.back() == 'x';
+    if (is_capture) {
+        san.remove_suffix(1);
+    }
+    // disambiguation, the file and then the rank of the moving piece
+    Bitboard from_mask = ~Bitboard {0};
+    bool file_given = false;
+    if (!san.empty() && san.front() >= 'a' && san.front() <= 'h') {
+        from_mask &= file_a << (san.front() - 'a');
+        file_given = true;
+        san.remove_prefix(1);
+    }
+    if (!san.empty() && san.front() >= '1' && san.front() <= '8') {
+        from_mask &= Bitboard {0xFF} << (8 * (san.front() - '1'));
+        san.remove_prefix(1);
+    }
+    if (!san.empty()) {
+        VLOG(3) << "unexpected characters left in san: " << san;
+        return std::nullopt;
+    }
+
+    Color color = board.getNextMoveColor();
+    Color enemy_color = opposite_color(color);
+    Bitboard occupancy = board.occupancy();
+    if (board.occupancy(color) & squareBit(to)) {
+        return std::nullopt;
+    }
+    // the pieces of type which reach to, found by looking back from to
+    Bitboard candidates = 0;
+    switch (type) {
+        case Piece::Type::Pawn: {
+            Bitboard pawns = board.pieces(color, Piece::Type::Pawn);
+            int up = color == Color::White ? 8 : -8;
+            if (is_capture || file_given) {
+                bool en_passant = board.getEnPassantSquare().has_value() && squareIndex(board.getEnPassantSquare().value()) == to;
+                if ((board.occupancy(enemy_color) & squareBit(to)) || en_passant) {
+                    candidates = pawnAttacks(enemy_color, to) & pawns;
+                }
+            } else if (!(occupancy & squareBit(to))) {
+                std::uint8_t single = static_cast<std::uint8_t>(to - up);
+                std::uint8_t double_push_row = color == Color::White ? 3 : 4;
+                if (pawns & squareBit(single)) {
+                    candidates = squareBit(single);
+                } else if (to / 8 == double_push_row && !(occupancy & squareBit(single))) {
+                    candidates = pawns & squareBit(static_cast<std::uint8_t>(to - 2 * up));
                 }
             }
+            bool promotion_rank = (squareBit(to) & promotion_ranks) != 0;
+            if (promotion_rank != promotion_to.has_value()) {
+                VLOG(3) << "pawn move to " << squareAt(to) << " has to promote exactly when it reaches the last rank";
+                return std::nullopt;
+            }
+            break;
+        }
+        default:
+            candidates = piece_sources(board, color, type, to);
+            break;
+    }
+    if (type != Piece::Type::Pawn && promotion_to.has_value()) {
+        return std::nullopt;
+    }
+    candidates &= from_mask;
+    // Checking the king is safe costs a few attack lookups per candidate. With several candidates only a
+    // pin can rule one out, san leaves out what the rules already decide.
+    std::optional<Move> result = std::nullopt;
+    while (candidates) {
+        Move move {squareAt(popLsb(candidates)), squareAt(to), promotion_to};
+        if (!is_pseudo_legal_move_legal(board, move)) {
+            continue;
+        }
+        if (result.has_value()) {
+            VLOG(3) << "san " << move << " is ambiguous";
+            return std::nullopt;
+        }
+        result = move;
+    }
+    return result;
+}
+
+std::pair<bool, bool> sanDisambiguation(Board const& board, Move const& move) {
+    Color color = board.getNextMoveColor();
+    std::uint8_t from = squareIndex(move.fromSquare);
+    std::optional<Piece::Type> type = board.typeAt(color, from);
+    // pawn captures always name their file and pushes cant be confused, there is only one king
+    if (!type.has_value() || type == Piece::Type::Pawn || type == Piece::Type::King) {
+        return std::make_pair(false, false);
+    }
+    Bitboard others = piece_sources(board, color, type.value(), squareIndex(move.toSquare)) & ~squareBit(from);
+    bool is_file_needed = false;
+    bool is_rank_needed = false;
+    while (others) {
+        Square other = squareAt(popLsb(others));
+        if (!is_pseudo_legal_move_legal(board, Move {other, move.toSquare})) {
+            continue;
+        }
+        if (other.col != move.fromSquare.col) {
+            is_file_needed = true;
+        } else {
+            is_rank_needed = true;
+        }
+    }
+    return std::make_pair(is_file_needed, is_rank_needed);
+}
+
+bool hasUpcomingRepetition(Board const& board, std::vector<std::uint64_t> const& positionKeys) {
+    assert(!positionKeys.empty() && positionKeys.back() == board.hash());
+    std::size_t reach = std::min(board.getHalfMoveClock(), positionKeys.size() - 1);
+    std::uint64_t key = board.hash();
+    auto const& table = cuckoo_table();
+    // one move away are positions with the other side to move, and going back to the position
+    // just before the opponent's last move would take the opponent's piece
+    for (std::size_t back = 3; back <= reach; back += 2) {
+        std::uint64_t move_key = key ^ positionKeys[positionKeys.size() - 1 - back];
+        CuckooEntry const* entry = &table[cuckoo_h1(move_key)];
+        if (entry->key != move_key) {
+            entry = &table[cuckoo_h2(move_key)];
+            if (entry->key != move_key) {
+                continue;
+            }
+        }
+        if (betweenSquares(entry->a, entry->b) & board.occupancy()) {
+            continue;
+        }
+        Color color = static_cast<Color>(entry->piece_index / 6);
+        Piece::Type type = static_cast<Piece::Type>(entry->piece_index % 6);
+        Bitboard ends = squareBit(entry->a) | squareBit(entry->b);
+        // the piece has to be on one end with the other end empty, and it has to be ours to move
+        if (color == board.getNextMoveColor() && (board.pieces(color, type) & ends) && popCount(board.occupancy() & ends) == 1) {
+            return true;
         }
     }
-    VLOG(4) << "determined that king capture is not possible in theoretical position";
     return false;
 }
 
+bool isKingCapturePossibleNextMove(ChessEngineLib::Board const& board) {
+    return is_king_attacked(board, opposite_color(board.getNextMoveColor()));
+}
+
+Bitboard attackersTo(Board const& board, Square square) {
+    return attackers_to(board, squareIndex(square), board.occupancy());
+}
+
+bool isSquareAttacked(Board const& board, Square square, Color byColor) {
+    return is_square_attacked(board, squareIndex(square), byColor, board.occupancy());
+}
+
 std::ostream & operator<<(std::ostream &os, ResultType rt) {
     switch (rt) {
         case ResultType::Draw:
@@ -504,22 +1215,17 @@ std::optional<ResultType> isGameOver(Board const& board) {
         VLOG(2) << "game over because of 50 move rule";
         return ResultType::Draw;
     }
+    if (board.isInsufficientMaterial()) {
+        VLOG(2) << "game over because neither side has enough material to checkmate";
+        return ResultType::Draw;
+    }
     VLOG(2) << "try to check if there are any legal moves to determine if match is over";
-    for (std::uint8_t col=0; col<8; col++) {
-        for (std::uint8_t row=0; row<8; row++) {
-            std::unordered_set<Square> legal_moves = generateLegalDestinations(board, {col, row});
-            if (!legal_moves.empty()) {
-                VLOG(4) << "found " << legal_moves.size() << " legal moves from ("
-                    << +col << ", " << +row << "), so not game over";
-                return std::nullopt;
-            }
-        }
+    if (has_any_legal_move(board)) {
+        VLOG(4) << "found a legal move, so not game over";
+        return std::nullopt;
     }
     VLOG(2) << "no legal moves try to determine if stalemate or checkmate";
-    Board board_copy = board;
-    Color color = board.getNextMoveColor() == Color::White ? Color::Black : Color::White;
-    board_copy.setNextMoveColor(color);
-    if (!isKingCapturePossibleNextMove(board_copy)) {
+    if (!is_king_attacked(board, board.getNextMoveColor())) {
         return ResultType::Draw;
     }
     if (board.getNextMoveColor() == Color::White) {
@@ -530,29 +1236,9 @@ std::optional<ResultType> isGameOver(Board const& board) {
 }
 
 std::unordered_set<Move> getAllLegalMoves(Board const& board) {
-    auto is_pawn_promotion = [] (Piece const& piece, Square dst) -> bool {
-        return (piece.type == Piece::Type::Pawn) &&
-            ((piece.color == Color::White && dst.row == 7) ||
-            (piece.color == Color::Black && dst.row == 0));
-    };
-    std::unordered_set<Move> legal_moves {};
-    for (std::uint8_t col=0; col<8; col++) {
-        for (std::uint8_t row=0; row<8; row++) {
-            std::unordered_set<Square> legal_dsts = generateLegalDestinations(board, {col, row});
-            for (Square dst: legal_dsts) {
-                Piece const& piece = board.at({col, row}).value();
-                if (is_pawn_promotion(piece, dst)) {
-                    legal_moves.insert(Move(Square {col, row}, dst, Piece::Type::Rook));
-                    legal_moves.insert(Move(Square {col, row}, dst, Piece::Type::Queen));
-                    legal_moves.insert(Move(Square {col, row}, dst, Piece::Type::Bishop));
-                    legal_moves.insert(Move(Square {col, row}, dst, Piece::Type::Knight));
-                } else {
-                    legal_moves.insert(Move(Square {col, row}, dst));
-                }
-            }
-        }
-    }
-    return legal_moves;
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    return std::unordered_set<Move>(moves.begin(), moves.end());
 }
 
 bool isMoveLegal(Board const& board, Move const& move) {
@@ -560,13 +1246,25 @@ bool isMoveLegal(Board const& board, Move const& move) {
     if(!isMovePseudoLegal(board, move)) {
         return false;
     }
-    Board board_copy = board;
-    board_copy.forceMakeMove(move);
-    if (isKingCapturePossibleNextMove(board_copy)) {
+    if (!is_pseudo_legal_move_legal(board, move)) {
         VLOG(2) << "illegal move because king would die immediately";
         return false;
     }
     return true;
 }
 
+bool isPackedMoveLegal(Board const& board, PackedMove move) {
+    std::optional<Piece::Type> type = board.typeAt(board.getNextMoveColor(), move.from());
+    if (!type.has_value()) {
+        return false;
+    }
+    // the generator makes every pawn move to the last rank a promotion and no other move
+    bool must_promote = type.value() == Piece::Type::Pawn && (squareBit(move.to()) & promotion_ranks);
+    if (move.promotionTo().has_value() != must_promote) {
+        return false;
+    }
+    Bitboard dsts = legal_destinations(board, squareAt(move.from()), type.value(), legality_info(board));
+    return dsts & squareBit(move.to());
+}
+
 }
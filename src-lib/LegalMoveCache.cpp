@@ -0,0 +1,100 @@
+#include "LegalMoveCache.hpp"
+#include "GameEngine.hpp"
+#include "glog/logging.h"
+
+namespace {
+
+// generation work grows with the number of moves, the constant stands for the fixed cost of a position
+std::uint64_t regeneration_cost(std::size_t move_count) {
+    return move_count + 8;
+}
+
+}
+
+namespace ChessEngineLib {
+
+LegalMoveCache::LegalMoveCache(std::size_t capacity) {
+    std::size_t buckets = 1;
+    while (buckets * ways < capacity) {
+        buckets *= 2;
+    }
+    m_bucketCount = buckets;
+    m_buckets = std::make_unique<Bucket[]>(buckets);
+}
+
+void LegalMoveCache::legalMoves(Board const& board, MoveList& moves) {
+    std::uint64_t key = board.hash();
+    {
+        Bucket& bucket = bucketFor(key);
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        for (Entry& entry: bucket.entries) {
+            if (!entry.used || entry.key != key || entry.occupancy != board.occupancy()) {
+                continue;
+            }
+            entry.uses++;
+            entry.priority = bucket.inflation + entry.uses * regeneration_cost(entry.moves.size());
+            for (PackedMove move: entry.moves) {
+                moves.push_back(move);
+            }
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    // generate without holding the lock, other threads may use the bucket meanwhile
+    MoveList generated;
+    generateLegalMoves(board, generated);
+    insert(board, generated);
+    for (std::size_t i = 0; i < generated.size(); i++) {
+        moves.push_back(generated.packed(i));
+    }
+}
+
+void LegalMoveCache::insert(Board const& board, MoveList const& moves) {
+    std::uint64_t key = board.hash();
+    Bucket& bucket = bucketFor(key);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    Entry* victim = &bucket.entries[0];
+    for (Entry& entry: bucket.entries) {
+        if (entry.used && entry.key == key && entry.occupancy == board.occupancy()) {
+            // another thread got here first
+            return;
+        }
+        if (!entry.used) {
+            victim = &entry;
+            break;
+        }
+        if (entry.priority < victim->priority) {
+            victim = &entry;
+        }
+    }
+    if (victim->used) {
+        VLOG(5) << "evicting legal moves of hash " << victim->key << " with priority " << victim->priority;
+        bucket.inflation = victim->priority;
+    }
+    victim->key = key;
+    victim->occupancy = board.occupancy();
+    victim->uses = 1;
+    victim->priority = bucket.inflation + regeneration_cost(moves.size());
+    victim->used = true;
+    // keeps the capacity of the vector so a warm cache stops allocating
+    victim->moves.clear();
+    for (std::size_t i = 0; i < moves.size(); i++) {
+        victim->moves.push_back(moves.packed(i));
+    }
+}
+
+void LegalMoveCache::clear() {
+    for (std::size_t i = 0; i < m_bucketCount; i++) {
+        Bucket& bucket = m_buckets[i];
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        bucket.inflation = 0;
+        for (Entry& entry: bucket.entries) {
+            entry.used = false;
+        }
+    }
+    m_hits.store(0, std::memory_order_relaxed);
+    m_misses.store(0, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,158 @@
+#include "MovePicker.hpp"
+#include "Bitboard.hpp"
+#include "Board.hpp"
+#include "GameEngine.hpp"
+#include "Move.hpp"
+#include "glog/logging.h"
+
+#include <limits>
+
+namespace {
+
+// marks a capture which was already returned
+constexpr int taken_score = std::numeric_limits<int>::min();
+
+int piece_value(ChessEngineLib::Piece::Type type) {
+    switch (type) {
+        case ChessEngineLib::Piece::Type::Pawn:
+            return 1;
+        case ChessEngineLib::Piece::Type::Knight:
+        case ChessEngineLib::Piece::Type::Bishop:
+            return 3;
+        case ChessEngineLib::Piece::Type::Rook:
+            return 5;
+        case ChessEngineLib::Piece::Type::Queen:
+            return 9;
+        case ChessEngineLib::Piece::Type::King:
+            return 0;
+    }
+    return 0;
+}
+
+// most valuable victim first, then least valuable attacker, promotions count as capturing the new piece
+int mvv_lva_score(ChessEngineLib::Board const& board, ChessEngineLib::PackedMove move) {
+    using namespace ChessEngineLib;
+    Color color = board.getNextMoveColor();
+    Color enemy_color = color == Color::White ? Color::Black : Color::White;
+    int victim = 0;
+    if (move.kind() == PackedMove::Kind::EnPassant) {
+        victim = piece_value(Piece::Type::Pawn);
+    } else if (std::optional<Piece::Type> captured = board.typeAt(enemy_color, move.to())) {
+        victim = piece_value(captured.value());
+    }
+    if (move.promotionTo().has_value()) {
+        victim += piece_value(move.promotionTo().value());
+    }
+    Piece::Type attacker = board.typeAt(color, move.from()).value();
+    return victim * 16 - static_cast<int>(attacker);
+}
+
+// ignores the kind, which a move coming from another position may not have set the same way
+bool same_move(ChessEngineLib::PackedMove a, ChessEngineLib::PackedMove b) {
+    return a.from() == b.from() && a.to() == b.to() && a.promotionTo() == b.promotionTo();
+}
+
+}
+
+namespace ChessEngineLib {
+
+MovePicker::MovePicker(Board const& board, PackedMove hashMove, std::array<PackedMove, 2> const& killers):
+m_board(board),
+m_hashMove(hashMove),
+m_killers(killers)
+{}
+
+bool MovePicker::isQuiet(PackedMove move) const {
+    if (m_board.occupancy() & squareBit(move.to())) {
+        return false;
+    }
+    if (move.promotionTo().has_value()) {
+        return false;
+    }
+    bool is_pawn_move = m_board.pieces(m_board.getNextMoveColor(), Piece::Type::Pawn) & squareBit(move.from());
+    return !(is_pawn_move && m_board.getEnPassantSquare() == squareAt(move.to()));
+}
+
+bool MovePicker::alreadyReturned(PackedMove move) const {
+    if (m_hashMoveReturned && same_move(move, m_hashMove)) {
+        return true;
+    }
+    for (PackedMove killer: m_returnedKillers) {
+        if (!killer.isNull() && same_move(move, killer)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<Move> MovePicker::next() {
+    while (true) {
+        switch (m_stage) {
+            case Stage::HashMove:
+                m_stage = Stage::GenerateCaptures;
+                if (!m_hashMove.isNull() && isPackedMoveLegal(m_board, m_hashMove)) {
+                    VLOG(5) << "returning hash move " << m_hashMove;
+                    m_hashMoveReturned = true;
+                    return m_hashMove.toMove();
+                }
+                break;
+            case Stage::GenerateCaptures:
+                generateLegalCaptures(m_board, m_moves);
+                for (std::size_t i = 0; i < m_moves.size(); i++) {
+                    m_scores[i] = alreadyReturned(m_moves.packed(i)) ? taken_score : mvv_lva_score(m_board, m_moves.packed(i));
+                }
+                m_stage = Stage::Captures;
+                break;
+            case Stage::Captures: {
+                // pick the best remaining capture each time instead of sorting, a cutoff usually comes early
+                std::size_t best = m_moves.size();
+                for (std::size_t i = 0; i < m_moves.size(); i++) {
+                    if (m_scores[i] != taken_score && (best == m_moves.size() || m_scores[i] > m_scores[best])) {
+                        best = i;
+                    }
+                }
+                if (best == m_moves.size()) {
+                    m_stage = Stage::Killers;
+                    break;
+                }
+                m_scores[best] = taken_score;
+                return m_moves[best];
+            }
+            case Stage::Killers:
+                while (m_killerIndex < m_killers.size()) {
+                    PackedMove killer = m_killers[m_killerIndex];
+                    m_killerIndex++;
+                    if (killer.isNull() || alreadyReturned(killer) || !isQuiet(killer)) {
+                        continue;
+                    }
+                    if (isPackedMoveLegal(m_board, killer)) {
+                        VLOG(5) << "returning killer move " << killer;
+                        m_returnedKillers[m_killerIndex - 1] = killer;
+                        return killer.toMove();
+                    }
+                }
+                m_stage = Stage::GenerateQuiets;
+                break;
+            case Stage::GenerateQuiets:
+                m_moves.clear();
+                m_index = 0;
+                generateLegalQuietMoves(m_board, m_moves);
+                m_stage = Stage::Quiets;
+                break;
+            case Stage::Quiets:
+                while (m_index < m_moves.size()) {
+                    PackedMove move = m_moves.packed(m_index);
+                    m_index++;
+                    if (!alreadyReturned(move)) {
+                        return move.toMove();
+                    }
+                }
+                m_stage = Stage::Done;
+                break;
+            case Stage::Done:
+                return std::nullopt;
+        }
+    }
+}
+
+}
@@ -0,0 +1,284 @@
+#include "Perft.hpp"
+#include "Bitboard.hpp"
+#include "Board.hpp"
+#include "GameEngine.hpp"
+#include "Move.hpp"
+#include "MoveList.hpp"
+#include "glog/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+
+namespace {
+
+bool is_in_check(ChessEngineLib::Board const& board) {
+    using namespace ChessEngineLib;
+    Color color = board.getNextMoveColor();
+    std::optional<Square> king = board.kingSquare(color);
+    Color enemy_color = color == Color::White ? Color::Black : Color::White;
+    return king.has_value() && isSquareAttacked(board, king.value(), enemy_color);
+}
+
+std::uint64_t perft_recursive(ChessEngineLib::Board& board, std::size_t depth) {
+    using namespace ChessEngineLib;
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    if (depth == 1) {
+        return moves.size();
+    }
+    std::uint64_t nodes = 0;
+    for (Move const& move: moves) {
+        Board::UndoInfo undo = board.makeMove(move);
+        nodes += perft_recursive(board, depth - 1);
+        board.unmakeMove(move, undo);
+    }
+    return nodes;
+}
+
+// Shared between threads without locks. Each entry stores the key xor'ed with the data, so an entry
+// torn by two threads writing at once does not verify against any key and reads as a miss.
+class PerftHashTable {
+public:
+    explicit PerftHashTable(std::size_t entries) {
+        std::size_t size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+        m_entries = std::vector<Entry>(size);
+        m_mask = size - 1;
+    }
+
+    std::optional<std::uint64_t> probe(std::uint64_t hash, std::size_t depth) const {
+        Entry const& entry = m_entries[hash & m_mask];
+        std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+        std::uint64_t key = entry.key.load(std::memory_order_relaxed);
+        if ((key ^ data) != hash || (data & depth_mask) != depth) {
+            return std::nullopt;
+        }
+        return data >> depth_bits;
+    }
+
+    void store(std::uint64_t hash, std::size_t depth, std::uint64_t nodes) {
+        assert(depth <= depth_mask);
+        assert(nodes < (std::uint64_t {1} << (64 - depth_bits)));
+        std::uint64_t data = (nodes << depth_bits) | depth;
+        Entry& entry = m_entries[hash & m_mask];
+        entry.key.store(hash ^ data, std::memory_order_relaxed);
+        entry.data.store(data, std::memory_order_relaxed);
+    }
+
+private:
+    // low bits of data hold the depth, the rest the node count
+    static constexpr unsigned depth_bits = 8;
+    static constexpr std::uint64_t depth_mask = (std::uint64_t {1} << depth_bits) - 1;
+
+    struct Entry {
+        std::atomic<std::uint64_t> key {0};
+        std::atomic<std::uint64_t> data {0};
+    };
+    std::vector<Entry> m_entries;
+    std::size_t m_mask;
+};
+
+std::uint64_t perft_hashed(ChessEngineLib::Board& board, std::size_t depth, PerftHashTable* table) {
+    using namespace ChessEngineLib;
+    if (depth == 1 || table == nullptr) {
+        return perft_recursive(board, depth);
+    }
+    std::optional<std::uint64_t> cached = table->probe(board.hash(), depth);
+    if (cached.has_value()) {
+        return cached.value();
+    }
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    std::uint64_t nodes = 0;
+    for (Move const& move: moves) {
+        Board::UndoInfo undo = board.makeMove(move);
+        nodes += perft_hashed(board, depth - 1, table);
+        board.unmakeMove(move, undo);
+    }
+    table->store(board.hash(), depth, nodes);
+    return nodes;
+}
+
+void perft_detailed_recursive(ChessEngineLib::Board& board, std::size_t depth, ChessEngineLib::PerftStats& stats) {
+    using namespace ChessEngineLib;
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    Color color = board.getNextMoveColor();
+    for (Move const& move: moves) {
+        if (depth > 1) {
+            Board::UndoInfo undo = board.makeMove(move);
+            perft_detailed_recursive(board, depth - 1, stats);
+            board.unmakeMove(move, undo);
+            continue;
+        }
+        bool is_pawn_move = board.pieces(color, Piece::Type::Pawn) & squareBit(move.fromSquare);
+        bool is_king_move = board.pieces(color, Piece::Type::King) & squareBit(move.fromSquare);
+        bool is_en_passant = is_pawn_move && board.getEnPassantSquare() == move.toSquare &&
+            move.fromSquare.col != move.toSquare.col;
+        bool is_castle = is_king_move && std::abs(move.fromSquare.col - move.toSquare.col) == 2;
+
+        Board::UndoInfo undo = board.makeMove(move);
+        stats.nodes++;
+        if (undo.capturedType.has_value()) {
+            stats.captures++;
+        }
+        if (is_en_passant) {
+            stats.enPassants++;
+        }
+        if (is_castle) {
+            stats.castles++;
+        }
+        if (move.promotionTo.has_value()) {
+            stats.promotions++;
+        }
+        if (is_in_check(board)) {
+            stats.checks++;
+            MoveList replies;
+            generateLegalMoves(board, replies);
+            if (replies.empty()) {
+                stats.checkmates++;
+            }
+        }
+        board.unmakeMove(move, undo);
+    }
+}
+
+}
+
+namespace ChessEngineLib {
+
+PerftStats& PerftStats::operator+=(PerftStats const& other) {
+    nodes += other.nodes;
+    captures += other.captures;
+    enPassants += other.enPassants;
+    castles += other.castles;
+    promotions += other.promotions;
+    checks += other.checks;
+    checkmates += other.checkmates;
+    return *this;
+}
+
+bool PerftStats::operator==(PerftStats const& other) const {
+    return nodes == other.nodes &&
+        captures == other.captures &&
+        enPassants == other.enPassants &&
+        castles == other.castles &&
+        promotions == other.promotions &&
+        checks == other.checks &&
+        checkmates == other.checkmates;
+}
+
+bool PerftStats::operator!=(PerftStats const& other) const {
+    return !(*this == other);
+}
+
+std::ostream & operator<<(std::ostream &os, PerftStats const& stats) {
+    os << "nodes=" << stats.nodes
+        << " captures=" << stats.captures
+        << " enPassants=" << stats.enPassants
+        << " castles=" << stats.castles
+        << " promotions=" << stats.promotions
+        << " checks=" << stats.checks
+        << " checkmates=" << stats.checkmates;
+    return os;
+}
+
+std::uint64_t perft(Board const& board, std::size_t depth) {
+    VLOG(1) << "perft of depth " << depth << " for board " << board;
+    if (depth == 0) {
+        return 1;
+    }
+    Board board_copy = board;
+    return perft_recursive(board_copy, depth);
+}
+
+PerftStats perftDetailed(Board const& board, std::size_t depth) {
+    VLOG(1) << "detailed perft of depth " << depth << " for board " << board;
+    PerftStats stats {};
+    if (depth == 0) {
+        stats.nodes = 1;
+        return stats;
+    }
+    Board board_copy = board;
+    perft_detailed_recursive(board_copy, depth, stats);
+    return stats;
+}
+
+std::vector<std::pair<Move, std::uint64_t>> perftDivide(Board const& board, std::size_t depth) {
+    std::vector<std::pair<Move, std::uint64_t>> result {};
+    if (depth == 0) {
+        return result;
+    }
+    Board board_copy = board;
+    MoveList moves;
+    generateLegalMoves(board_copy, moves);
+    for (Move const& move: moves) {
+        Board::UndoInfo undo = board_copy.makeMove(move);
+        result.emplace_back(move, depth == 1 ? 1 : perft_recursive(board_copy, depth - 1));
+        board_copy.unmakeMove(move, undo);
+    }
+    return result;
+}
+
+std::vector<std::pair<Move, std::uint64_t>> perftDivideParallel(
+    Board const& board, std::size_t depth, std::size_t threads, std::size_t hashTableEntries
+) {
+    VLOG(1) << "parallel perft of depth " << depth << " with " << threads << " threads for board " << board;
+    std::vector<std::pair<Move, std::uint64_t>> result {};
+    if (depth == 0) {
+        return result;
+    }
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    for (Move const& move: moves) {
+        result.emplace_back(move, 0);
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, result.size());
+
+    std::optional<PerftHashTable> table {};
+    if (hashTableEntries > 0 && depth > 2) {
+        table.emplace(hashTableEntries);
+    }
+    // threads take the next root move until there are none left, so a thread stuck in a big subtree does not hold up the rest
+    std::atomic<std::size_t> next_root_move {0};
+    auto worker = [&]() {
+        Board board_copy = board;
+        for (std::size_t i = next_root_move.fetch_add(1); i < result.size(); i = next_root_move.fetch_add(1)) {
+            Move const& move = result[i].first;
+            Board::UndoInfo undo = board_copy.makeMove(move);
+            result[i].second = depth == 1 ? 1 : perft_hashed(board_copy, depth - 1, table.has_value() ? &table.value() : nullptr);
+            board_copy.unmakeMove(move, undo);
+        }
+    };
+    std::vector<std::thread> workers {};
+    for (std::size_t i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t: workers) {
+        t.join();
+    }
+    return result;
+}
+
+std::uint64_t perftParallel(Board const& board, std::size_t depth, std::size_t threads, std::size_t hashTableEntries) {
+    if (depth == 0) {
+        return 1;
+    }
+    std::uint64_t nodes = 0;
+    for (auto const& divided: perftDivideParallel(board, depth, threads, hashTableEntries)) {
+        nodes += divided.second;
+    }
+    return nodes;
+}
+
+}
@@ -1,5 +1,6 @@
 #include "RandomMovePlayer.hpp"
 #include "GameEngine.hpp"
+#include "MoveList.hpp"
 #include "glog/logging.h"
 
 #include  <random>
@@ -8,21 +9,18 @@ namespace ChessEngineLib {
 
 std::optional<Move> RandomMovePlayer::getMove(Board const& board) {
     VLOG(2) << "getMove called on board " << board;
-    std::unordered_set<Move> moves = getAllLegalMoves(board);
+    MoveList moves;
+    if (m_legalMoveCache != nullptr) {
+        m_legalMoveCache->legalMoves(board, moves);
+    } else {
+        generateLegalMoves(board, moves);
+    }
     if (moves.empty()) {
         return std::nullopt;
     }
-    std::vector<Move> out;
-    std::size_t const nelems = 1;
-    std::sample(
-        moves.begin(),
-        moves.end(),
-        std::back_inserter(out),
-        nelems,
-        std::mt19937{std::random_device{}()}
-    );
-    return std::move(out.front());
+    thread_local std::mt19937 generator {std::random_device{}()};
+    std::uniform_int_distribution<std::size_t> distribution {0, moves.size() - 1};
+    return moves[distribution(generator)];
 }
 
 }
-
@@ -0,0 +1,105 @@
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "Move.hpp"
+
+namespace ChessEngineLib {
+
+// One bit per square, bit index = row * 8 + col (a1 = 0, h1 = 7, a8 = 56)
+using Bitboard = std::uint64_t;
+
+constexpr std::uint8_t squareIndex(Square square) {
+    return static_cast<std::uint8_t>(square.row * 8 + square.col);
+}
+
+constexpr Square squareAt(std::uint8_t index) {
+    return Square {static_cast<std::uint8_t>(index % 8), static_cast<std::uint8_t>(index / 8)};
+}
+
+constexpr Bitboard squareBit(std::uint8_t index) {
+    return Bitboard {1} << index;
+}
+
+constexpr Bitboard squareBit(Square square) {
+    return squareBit(squareIndex(square));
+}
+
+inline int popCount(Bitboard b) {
+#if defined(_MSC_VER)
+    return static_cast<int>(__popcnt64(b));
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+
+// b must not be empty
+inline std::uint8_t lsbIndex(Bitboard b) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, b);
+    return static_cast<std::uint8_t>(index);
+#else
+    return static_cast<std::uint8_t>(__builtin_ctzll(b));
+#endif
+}
+
+// removes the least significant bit from b and returns its index, b must not be empty
+inline std::uint8_t popLsb(Bitboard& b) {
+    std::uint8_t index = lsbIndex(b);
+    b &= b - 1;
+    return index;
+}
+
+// The squares of a bitboard from a1 to h8, for range-for loops: for (Square s: SquareRange(b))
+class SquareRange {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Square;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Square;
+
+        explicit constexpr iterator(Bitboard remaining): m_remaining(remaining) {}
+        Square operator*() const {
+            return squareAt(lsbIndex(m_remaining));
+        }
+        iterator& operator++() {
+            m_remaining &= m_remaining - 1;
+            return *this;
+        }
+        constexpr bool operator==(iterator const& other) const {
+            return m_remaining == other.m_remaining;
+        }
+        constexpr bool operator!=(iterator const& other) const {
+            return m_remaining != other.m_remaining;
+        }
+
+    private:
+        Bitboard m_remaining;
+    };
+
+    explicit constexpr SquareRange(Bitboard squares): m_squares(squares) {}
+    constexpr iterator begin() const {
+        return iterator(m_squares);
+    }
+    constexpr iterator end() const {
+        return iterator(0);
+    }
+
+private:
+    Bitboard m_squares;
+};
+
+}
+
+#endif
@@ -2,10 +2,12 @@
 #define BOARD_HPP
 
 #include <string>
+#include <string_view>
 #include <array>
 #include <optional>
 #include <unordered_map>
 
+#include "Bitboard.hpp"
 #include "Move.hpp"
 
 namespace ChessEngineLib {
@@ -16,20 +18,63 @@ enum Side {
 
 class Board {
 public:
-    static std::optional<Board> fromFen(std::string const& fen);
+    static std::optional<Board> fromFen(std::string_view fen);
     static Board startingPosBoard();
     ~Board() = default;
 
     using Board2dArray = std::array<std::array<std::optional<Piece>, 8>, 8>;
-    Board2dArray const& grid() const;
-    std::optional<Piece> const& at(Square square) const;
+    // grid() and at() are views built from the bitboards, prefer pieces()/occupancy() in hot code
+    Board2dArray grid() const;
+    std::optional<Piece> at(Square square) const;
+    Bitboard pieces(Color color, Piece::Type type) const {
+        return m_pieces[color * 6 + type];
+    }
+    // for (Square s: board.pieceSquares(Color::White, Piece::Type::Knight)), costs one step per piece
+    SquareRange pieceSquares(Color color, Piece::Type type) const {
+        return SquareRange(pieces(color, type));
+    }
+    // what color has on square_index, cheaper than at() when the color is known
+    std::optional<Piece::Type> typeAt(Color color, std::uint8_t square_index) const;
+    int pieceCount(Color color, Piece::Type type) const {
+        return popCount(pieces(color, type));
+    }
+    // Zobrist key of how many pieces of each kind there are regardless of where they stand,
+    // equal for positions with the same material so it can key endgame and tablebase lookups
+    std::uint64_t materialKey() const {
+        return m_materialKey;
+    }
+    // neither side can possibly checkmate: bare kings, a single minor piece, or only bishops all on one square color
+    bool isInsufficientMaterial() const;
+    // nullopt only for positions set up without a king of that color
+    std::optional<Square> kingSquare(Color color) const {
+        Bitboard king = pieces(color, Piece::Type::King);
+        if (!king) {
+            return std::nullopt;
+        }
+        return squareAt(lsbIndex(king));
+    }
+    Bitboard occupancy(Color color) const {
+        return m_occupancy[color];
+    }
+    Bitboard occupancy() const {
+        return m_occupancy[Color::White] | m_occupancy[Color::Black];
+    }
     Color getNextMoveColor() const;
     bool isCastlingAvailable(Color color, Side side) const;
     std::size_t getHalfMoveClock() const; //For fifty move rule
     std::size_t getMoveNumber() const; // Starts at 1
     std::optional<Square> getEnPassantSquare() const; // Just behind the pawn that moved 2 squares
+    // Zobrist key of everything fenWithoutMoveNumbers() covers, kept up to date as moves are made
+    std::uint64_t hash() const {
+        return m_hash;
+    }
 
     std::string fen() const;
+    // enough for any fen writeFen can produce, even with the largest move numbers
+    static constexpr std::size_t maxFenLength = 128;
+    // Writes the fen into [first, last) without allocating, like std::to_chars.
+    // Returns one past the last character written, or nullptr if it didnt fit.
+    char* writeFen(char* first, char* last) const;
 
     // useful for encoding repetitions for threefold repetition
     std::string fenWithoutMoveNumbers() const;
@@ -40,6 +85,14 @@ public:
     void forceMakeMove(Move const& move);
     void setNextMoveColor(Color color);
 
+    // Everything makeMove overwrites which cant be worked out from the move itself.
+    // There is no undo stack inside Board, callers walking a tree keep one UndoInfo per ply.
+    struct UndoInfo;
+    // same as forceMakeMove, but the move can be taken back with unmakeMove
+    UndoInfo makeMove(Move const& move);
+    // move and undo must be exactly what was passed to and returned from the last makeMove
+    void unmakeMove(Move const& move, UndoInfo const& undo);
+
 private:
     struct CastlingAvailability {
         bool whiteQueenSide {true};
@@ -50,19 +103,48 @@ private:
     };
 
     Board() = default;
-    static std::optional<CastlingAvailability> parse_castling_availability(std::string const& fen_chunk);
+    static std::optional<CastlingAvailability> parse_castling_availability(std::string_view fen_chunk);
     void expireCastlingAvailability(Color color, Side side);
-
-    Board2dArray m_grid;
+    // makeMove for the side to move being Us, defined and instantiated in Board.cpp
+    template <Color Us>
+    UndoInfo makeMoveFor(Move const& move);
+    void putPiece(Piece const& piece, std::uint8_t square_index);
+    void removePiece(Piece const& piece, std::uint8_t square_index);
+    // the part of m_hash which isnt about pieces: side to move, castling and en passant
+    std::uint64_t stateHash() const;
+
+    // indexed by color * 6 + type
+    std::array<Bitboard, 12> m_pieces {};
+    std::array<Bitboard, 2> m_occupancy {};
     Color m_nextMoveColor {Color::Black};
     CastlingAvailability m_castlingAvailability {};
     std::size_t m_halfMoveClock {0};
     std::size_t m_moveNumber {0};
     std::optional<Square> m_enPassantSquare {std::nullopt};
+    std::uint64_t m_hash {0};
+    std::uint64_t m_materialKey {0};
+};
+
+struct Board::UndoInfo {
+    // color is always the opposite of the side which moved
+    std::optional<Piece::Type> capturedType;
+    CastlingAvailability castlingAvailability;
+    std::optional<Square> enPassantSquare;
+    std::size_t halfMoveClock;
+    std::uint64_t hash;
 };
 
 std::ostream & operator<<(std::ostream &os, Board const& b);
 
 }
 
+template<>
+struct std::hash<ChessEngineLib::Board>
+{
+    std::size_t operator()(ChessEngineLib::Board const& b) const noexcept
+    {
+        return static_cast<std::size_t>(b.hash());
+    }
+};
+
 #endif
@@ -7,6 +7,7 @@
 
 #include "Board.hpp"
 #include "Move.hpp"
+#include "PackedMove.hpp"
 #include "GameEngine.hpp"
 
 namespace ChessEngineLib {
@@ -14,8 +15,12 @@ namespace ChessEngineLib {
 class Game {
 
 public:
+    static constexpr std::size_t defaultCheckpointInterval = 64;
     Game();
-    static std::optional<Game> fromPgn(std::string const& pgn);
+    // A copy of the board is kept every checkpointInterval plies for boardAt and undo, which replay at
+    // most that many moves. Smaller intervals are faster to jump around in and take more memory, 0 is taken as 1.
+    explicit Game(std::size_t checkpointInterval);
+    static std::optional<Game> fromPgn(std::string const& pgn, std::size_t checkpointInterval = defaultCheckpointInterval);
 
     struct SevenTagRoster {
         std::string event;
@@ -60,6 +65,27 @@ public:
         }
     };
 
+    // MoveWithContext in four bytes, which is how a game keeps its moves. Castling is the kind of the
+    // packed move and the rest of the context is bits of flags_.
+    class PackedMoveWithContext {
+    public:
+        explicit PackedMoveWithContext(MoveWithContext const& mv);
+        MoveWithContext toMoveWithContext() const;
+
+    private:
+        enum Flag : std::uint8_t {
+            Capture = 1,
+            Check = 2,
+            Checkmate = 4,
+            SrcFileAmbigious = 8,
+            SrcRankAmbigious = 16,
+            WhitePiece = 32
+        };
+        PackedMove move_;
+        std::uint8_t pieceType_;
+        std::uint8_t flags_;
+    };
+
     std::string toPgn(bool with_roster = true) const;
     SevenTagRoster const& sevenTagRoster() const;
     std::optional<ResultType> result() const;
@@ -68,15 +94,33 @@ public:
     std::optional<MoveWithContext> moveAt(std::size_t halfMoveNum) const;
     std::size_t movesSize() const;
     Board const& board() const;
+    // position after the first ply half moves, boardAt(0) is the starting position, nullopt past the end
+    std::optional<Board> boardAt(std::size_t ply) const;
 
     bool makeMove(Move const& move);
+    // Same as makeMove for a move already known to be legal, such as one from generateLegalMoves or a
+    // search, without checking it again. The game must not be over yet.
+    void makeLegalMove(Move const& move);
+    // whether the side to move can bring back an earlier position of the game with a single move
+    bool hasUpcomingRepetition() const;
+    // takes back the last move, false if there is none, and the game is no longer over
+    bool undo();
 
 private:
     SevenTagRoster roster_;
-    std::vector<MoveWithContext> moves_;
+    std::vector<PackedMoveWithContext> moves_;
     std::optional<ResultType> result_;
     Board board_;
-    std::unordered_map<std::string, std::size_t> repetitions_;
+    // hash of every position since the last capture or pawn move, board_ last
+    std::vector<std::uint64_t> positionKeys_;
+    std::size_t checkpointInterval_;
+    // checkpoints_[i] is the board after i * checkpointInterval_ plies
+    std::vector<Board> checkpoints_;
+    // Moves after the first annotatedPlies_ were played through makeMove, whether they check and their
+    // disambiguation is only worked out when they are read, from the board they were made on.
+    std::size_t annotatedPlies_;
+
+    std::vector<MoveWithContext> annotatedMoves(std::size_t plies) const;
 };
 
 }
@@ -1,25 +1,62 @@
 #ifndef GAME_ENGINE_HPP
 #define GAME_ENGINE_HPP
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 #include <ostream>
 
 #include "Board.hpp"
 #include "Move.hpp"
+#include "MoveList.hpp"
 
 namespace ChessEngineLib {
 
-bool validateFen(std::string const& fen);
+bool validateFen(std::string_view fen);
 std::unordered_set<Square> generateLegalDestinations(Board const& board, Square source);
 // pseudo-legal is union of legal moves and moves which allow king capture next move
 std::unordered_set<Square> generatePseudoLegalDestinations(Board const& board, Square source);
 std::unordered_set<Move> getAllLegalMoves(Board const& board);
+// Allocation free variants of the above, append to moves
+void generatePseudoLegalMoves(Board const& board, MoveList& moves);
+void generateLegalMoves(Board const& board, MoveList& moves);
+// Split of generateLegalMoves into two disjoint halves. Captures include en passant and every promotion,
+// quiet moves are everything else including castling.
+void generateLegalCaptures(Board const& board, MoveList& moves);
+void generateLegalQuietMoves(Board const& board, MoveList& moves);
+// Same as generating the legal moves and checking for any, but stops at the first one found
+bool hasAnyLegalMove(Board const& board);
 
 bool makeMove(Board& board, Move const& move);
 bool isMovePseudoLegal(Board const& board, Move const& move);
 bool isMoveLegal(Board const& board, Move const& move);
+// Whether move is one of the moves generateLegalMoves gives for board, not looking at its kind. Unlike
+// isMoveLegal it follows the generator's rules, so the fifty move rule doesnt apply and a pawn reaching the
+// last rank has to promote. Meant for moves kept from other positions, such as hash and killer moves.
+bool isPackedMoveLegal(Board const& board, PackedMove move);
 bool isKingCapturePossibleNextMove(Board const& board);
+// pieces of both colors which attack square in the current position
+Bitboard attackersTo(Board const& board, Square square);
+bool isSquareAttacked(Board const& board, Square square, Color byColor);
+// whether the legal move leaves the opponent in check, worked out without making the move
+bool givesCheck(Board const& board, Move const& move);
+// Move for a move in standard algebraic notation such as "Nbd7", "exd6", "e8=Q+" or "O-O" by the side to move.
+// The result is legal and can be made with forceMakeMove. The candidates are found from the attackers of
+// the target square and only checked for king safety, no moves are generated.
+std::optional<Move> parseSan(Board const& board, std::string_view san);
+// Whether SAN needs the file and the rank of the source square of the legal move, to tell it apart
+// from other legal moves of the same kind of piece to the same square. Worked out from the attackers
+// of the destination, generating no moves.
+std::pair<bool, bool> sanDisambiguation(Board const& board, Move const& move);
+// Whether the side to move has a move, other than a pawn move or a capture, which brings back one of the
+// earlier positions in positionKeys. positionKeys holds the hash of every position so far, oldest first and
+// board's last, and only as far back as the halfmove clock is looked at. Uses a table of the hash changes of
+// all reversible moves, so it generates no moves. It also doesnt check the move for pins, so it can be
+// used to score a draw early in search.
+bool hasUpcomingRepetition(Board const& board, std::vector<std::uint64_t> const& positionKeys);
 
 enum class ResultType {
     Draw, WhiteWin, BlackWin
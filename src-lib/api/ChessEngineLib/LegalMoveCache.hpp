@@ -0,0 +1,76 @@
+#ifndef LEGAL_MOVE_CACHE_HPP
+#define LEGAL_MOVE_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Bitboard.hpp"
+#include "Board.hpp"
+#include "MoveList.hpp"
+#include "PackedMove.hpp"
+
+namespace ChessEngineLib {
+
+// Bounded cache of legal move lists keyed by position hash, for workloads which keep meeting the same
+// positions such as replaying many games from the same openings. Safe to share between threads.
+// Entries live in small buckets, when a bucket is full the entry which is cheapest to regenerate
+// relative to how often it was used is evicted, and every eviction ages the rest of the bucket.
+class LegalMoveCache {
+public:
+    // capacity is the number of positions kept, rounded up to a power of two
+    explicit LegalMoveCache(std::size_t capacity = std::size_t {1} << 14);
+    LegalMoveCache(LegalMoveCache const&) = delete;
+    LegalMoveCache& operator=(LegalMoveCache const&) = delete;
+
+    // appends the same moves as generateLegalMoves, from the cache when board was seen before
+    void legalMoves(Board const& board, MoveList& moves);
+
+    std::uint64_t hits() const {
+        return m_hits.load(std::memory_order_relaxed);
+    }
+    std::uint64_t misses() const {
+        return m_misses.load(std::memory_order_relaxed);
+    }
+    std::size_t capacity() const {
+        return m_bucketCount * ways;
+    }
+    void clear();
+
+private:
+    static constexpr std::size_t ways = 4;
+
+    struct Entry {
+        std::uint64_t key {0};
+        // guards against two positions with the same hash
+        Bitboard occupancy {0};
+        std::uint64_t priority {0};
+        std::uint32_t uses {0};
+        bool used {false};
+        std::vector<PackedMove> moves {};
+    };
+    struct Bucket {
+        std::mutex mutex;
+        // priority of the last entry evicted from this bucket, new and reused entries start above it
+        std::uint64_t inflation {0};
+        std::array<Entry, ways> entries {};
+    };
+
+    Bucket& bucketFor(std::uint64_t key) {
+        return m_buckets[key & (m_bucketCount - 1)];
+    }
+    void insert(Board const& board, MoveList const& moves);
+
+    std::size_t m_bucketCount;
+    std::unique_ptr<Bucket[]> m_buckets;
+    std::atomic<std::uint64_t> m_hits {0};
+    std::atomic<std::uint64_t> m_misses {0};
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <array>
 #include <optional>
 #include <ostream>
+#include <cstdint>
 #include <functional>
 
 namespace ChessEngineLib {
@@ -177,12 +178,14 @@ struct std::hash<ChessEngineLib::Move>
 {
     std::size_t operator()(ChessEngineLib::Move const& s) const noexcept
     {
-        std::size_t h1 = std::hash<ChessEngineLib::Square>{}(s.toSquare);
-        std::size_t h2 = std::hash<ChessEngineLib::Square>{}(s.fromSquare);
-        std::size_t h3 = std::hash<ChessEngineLib::Piece::Type>{}(
-            s.promotionTo.value_or(ChessEngineLib::Piece::Type::King)
-        );
-        return h1 ^ ((h2 ^ (h3 << 1)) << 1);
+        // every field gets its own bits so different moves never hash the same
+        std::uint64_t promotion = s.promotionTo.has_value() ? s.promotionTo.value() + 1 : 0;
+        std::uint64_t key = static_cast<std::uint64_t>(s.fromSquare.col) |
+            (static_cast<std::uint64_t>(s.fromSquare.row) << 8) |
+            (static_cast<std::uint64_t>(s.toSquare.col) << 16) |
+            (static_cast<std::uint64_t>(s.toSquare.row) << 24) |
+            (promotion << 32);
+        return std::hash<std::uint64_t>{}(key);
     }
 };
 
@@ -0,0 +1,102 @@
+#ifndef MOVE_LIST_HPP
+#define MOVE_LIST_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+#include "Move.hpp"
+#include "PackedMove.hpp"
+
+namespace ChessEngineLib {
+
+// Fixed capacity list of moves which lives entirely on the stack.
+// 256 is comfortably above the maximum number of legal moves in any chess position (218).
+// Moves are stored packed and handed out as Move by value.
+class MoveList {
+public:
+    static constexpr std::size_t capacity = 256;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Move;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Move;
+
+        explicit const_iterator(PackedMove const* position): m_position(position) {}
+        Move operator*() const {
+            return m_position->toMove();
+        }
+        const_iterator& operator++() {
+            ++m_position;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator before = *this;
+            ++m_position;
+            return before;
+        }
+        bool operator==(const_iterator const& other) const {
+            return m_position == other.m_position;
+        }
+        bool operator!=(const_iterator const& other) const {
+            return m_position != other.m_position;
+        }
+
+    private:
+        PackedMove const* m_position;
+    };
+
+    MoveList() {}
+
+    void push_back(PackedMove move) {
+        assert(m_size < capacity);
+        m_moves[m_size] = move;
+        m_size++;
+    }
+    void push_back(Move const& move) {
+        push_back(PackedMove(move));
+    }
+    void clear() {
+        m_size = 0;
+    }
+    std::size_t size() const {
+        return m_size;
+    }
+    bool empty() const {
+        return m_size == 0;
+    }
+    Move operator[](std::size_t i) const {
+        return packed(i).toMove();
+    }
+    PackedMove packed(std::size_t i) const {
+        assert(i < m_size);
+        return m_moves[i];
+    }
+    const_iterator begin() const {
+        return const_iterator(m_moves);
+    }
+    const_iterator end() const {
+        return const_iterator(m_moves + m_size);
+    }
+    bool contains(Move const& move) const {
+        // a plain Move has no kind, so compare only squares and promotion
+        for (Move const& m: *this) {
+            if (m == move) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::size_t m_size {0};
+    // left uninitialized, only the first m_size are ever read
+    PackedMove m_moves[capacity];
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef MOVE_PICKER_HPP
+#define MOVE_PICKER_HPP
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+
+#include "Board.hpp"
+#include "Move.hpp"
+#include "MoveList.hpp"
+#include "PackedMove.hpp"
+
+namespace ChessEngineLib {
+
+// Hands out the legal moves of a position one at a time, best candidates first:
+// the hash move, captures by most valuable victim / least valuable attacker, killer moves, then quiet moves.
+// Each stage is only generated once the previous one is used up, so a caller which stops early
+// (beta cutoff, or just checking that some move exists) skips generating the rest.
+// Every legal move is returned exactly once. The board must outlive the picker and not change meanwhile.
+class MovePicker {
+public:
+    // hashMove and killers may be null or not legal in board, in which case they are ignored
+    MovePicker(Board const& board, PackedMove hashMove = PackedMove {},
+        std::array<PackedMove, 2> const& killers = {PackedMove {}, PackedMove {}});
+    MovePicker(MovePicker const&) = delete;
+    MovePicker& operator=(MovePicker const&) = delete;
+
+    std::optional<Move> next();
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Move;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Move;
+
+        explicit iterator(MovePicker* picker):
+            m_picker(picker), m_current(picker != nullptr ? picker->next() : std::nullopt) {}
+        Move operator*() const {
+            return m_current.value();
+        }
+        iterator& operator++() {
+            m_current = m_picker->next();
+            return *this;
+        }
+        // only comparing against end() is meaningful
+        bool operator==(iterator const& other) const {
+            return m_current.has_value() == other.m_current.has_value();
+        }
+        bool operator!=(iterator const& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        MovePicker* m_picker;
+        std::optional<Move> m_current;
+    };
+    iterator begin() {
+        return iterator(this);
+    }
+    iterator end() {
+        return iterator(nullptr);
+    }
+
+private:
+    enum class Stage {
+        HashMove, GenerateCaptures, Captures, Killers, GenerateQuiets, Quiets, Done
+    };
+
+    bool isQuiet(PackedMove move) const;
+    bool alreadyReturned(PackedMove move) const;
+
+    Board const& m_board;
+    Stage m_stage {Stage::HashMove};
+    PackedMove m_hashMove;
+    std::array<PackedMove, 2> m_killers;
+    // killers which were legal and returned, the rest are null
+    std::array<PackedMove, 2> m_returnedKillers {PackedMove {}, PackedMove {}};
+    std::size_t m_killerIndex {0};
+    bool m_hashMoveReturned {false};
+    MoveList m_moves;
+    std::array<int, MoveList::capacity> m_scores;
+    std::size_t m_index {0};
+};
+
+}
+
+#endif
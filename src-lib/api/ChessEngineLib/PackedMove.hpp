@@ -0,0 +1,100 @@
+#ifndef PACKED_MOVE_HPP
+#define PACKED_MOVE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+
+#include "Bitboard.hpp"
+#include "Move.hpp"
+
+namespace ChessEngineLib {
+
+// Move in 16 bits, for move lists, move tables and stored games.
+// bits 0-5 from square index, 6-11 to square index, 12-13 promotion piece, 14-15 kind.
+// Converting a Move and back gives the same Move. Kind is extra information which the move
+// generator fills in and a plain Move does not have, so PackedMove(move) only sets Promotion.
+class PackedMove {
+public:
+    enum class Kind : std::uint8_t {
+        Normal, Promotion, EnPassant, Castle
+    };
+
+    // trivial so move lists can leave their slots uninitialized. PackedMove {} is all zero, a1 to a1,
+    // which is never a real move so it can mark empty slots in tables.
+    PackedMove() = default;
+
+    constexpr PackedMove(std::uint8_t from, std::uint8_t to, Kind kind = Kind::Normal,
+        Piece::Type promotion_to = Piece::Type::Knight
+    ): m_data(static_cast<std::uint16_t>(
+        from |
+        (to << 6) |
+        ((promotion_to - Piece::Type::Knight) << 12) |
+        (static_cast<std::uint16_t>(kind) << 14)
+    )) {
+        assert(from < 64 && to < 64);
+        assert(promotion_to >= Piece::Type::Knight && promotion_to <= Piece::Type::Queen);
+    }
+
+    explicit PackedMove(Move const& move): PackedMove(
+        squareIndex(move.fromSquare), squareIndex(move.toSquare),
+        move.promotionTo.has_value() ? Kind::Promotion : Kind::Normal,
+        move.promotionTo.value_or(Piece::Type::Knight)
+    ) {}
+
+    constexpr std::uint8_t from() const {
+        return m_data & 0x3f;
+    }
+    constexpr std::uint8_t to() const {
+        return (m_data >> 6) & 0x3f;
+    }
+    constexpr Kind kind() const {
+        return static_cast<Kind>(m_data >> 14);
+    }
+    constexpr std::optional<Piece::Type> promotionTo() const {
+        if (kind() != Kind::Promotion) {
+            return std::nullopt;
+        }
+        return static_cast<Piece::Type>(((m_data >> 12) & 0x3) + Piece::Type::Knight);
+    }
+    constexpr std::uint16_t raw() const {
+        return m_data;
+    }
+    constexpr bool isNull() const {
+        return m_data == 0;
+    }
+
+    Move toMove() const {
+        return Move(squareAt(from()), squareAt(to()), promotionTo());
+    }
+
+    constexpr bool operator==(PackedMove other) const {
+        return m_data == other.m_data;
+    }
+    constexpr bool operator!=(PackedMove other) const {
+        return m_data != other.m_data;
+    }
+
+private:
+    std::uint16_t m_data;
+};
+
+inline std::ostream & operator<<(std::ostream &os, PackedMove m) {
+    os << m.toMove();
+    return os;
+}
+
+}
+
+template<>
+struct std::hash<ChessEngineLib::PackedMove>
+{
+    std::size_t operator()(ChessEngineLib::PackedMove m) const noexcept
+    {
+        return std::hash<std::uint16_t>{}(m.raw());
+    }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PERFT_HPP
+#define PERFT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "Board.hpp"
+#include "Move.hpp"
+
+namespace ChessEngineLib {
+
+// Counts of the moves which lead to the leaves of a perft tree, same columns as the usual published perft tables
+struct PerftStats {
+    std::uint64_t nodes {0};
+    std::uint64_t captures {0};
+    std::uint64_t enPassants {0};
+    std::uint64_t castles {0};
+    std::uint64_t promotions {0};
+    std::uint64_t checks {0};
+    std::uint64_t checkmates {0};
+
+    PerftStats& operator+=(PerftStats const& other);
+    bool operator==(PerftStats const& other) const;
+    bool operator!=(PerftStats const& other) const;
+};
+std::ostream & operator<<(std::ostream &os, PerftStats const& stats);
+
+// Number of leaves of the tree of legal moves depth plies deep.
+// The last ply is counted in bulk from the size of the move list without making the moves.
+std::uint64_t perft(Board const& board, std::size_t depth);
+// Same as perft but makes every leaf move to classify it, much slower
+PerftStats perftDetailed(Board const& board, std::size_t depth);
+// perft of depth - 1 below each legal move from board, useful to find which move a generator bug hides under
+std::vector<std::pair<Move, std::uint64_t>> perftDivide(Board const& board, std::size_t depth);
+
+// perftDivide with the root moves shared out between threads (0 means one per hardware thread).
+// The threads share a lock-free table of subtree counts keyed by position hash and depth,
+// hashTableEntries is rounded down to a power of two and 0 turns the table off.
+// Results are identical to perftDivide.
+std::vector<std::pair<Move, std::uint64_t>> perftDivideParallel(
+    Board const& board, std::size_t depth, std::size_t threads, std::size_t hashTableEntries = std::size_t {1} << 20
+);
+std::uint64_t perftParallel(
+    Board const& board, std::size_t depth, std::size_t threads, std::size_t hashTableEntries = std::size_t {1} << 20
+);
+
+}
+
+#endif
@@ -1,13 +1,20 @@
 #ifndef RANDOM_MOVE_PLAYER_HPP
 #define RANDOM_MOVE_PLAYER_HPP
 
+#include "LegalMoveCache.hpp"
 #include "Player.hpp"
 
 namespace ChessEngineLib {
 
 class RandomMovePlayer : public Player {
 public:
+    RandomMovePlayer() = default;
+    // legalMoveCache is not owned and may be shared, it must outlive the player
+    explicit RandomMovePlayer(LegalMoveCache* legalMoveCache): m_legalMoveCache(legalMoveCache) {}
     std::optional<Move> getMove(Board const& board) override;
+
+private:
+    LegalMoveCache* m_legalMoveCache {nullptr};
 };
 
 }
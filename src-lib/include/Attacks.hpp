@@ -0,0 +1,166 @@
+#ifndef ATTACKS_HPP
+#define ATTACKS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Bitboard.hpp"
+#include "Move.hpp"
+
+#if defined(CHESS_ENGINE_ENABLE_PEXT) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHESS_ENGINE_PEXT_AVAILABLE 1
+#else
+#define CHESS_ENGINE_PEXT_AVAILABLE 0
+#endif
+
+namespace ChessEngineLib {
+
+// Sliding piece attacks are looked up in precomputed tables, indexed either by a magic multiply
+// or, on CPUs with fast BMI2, by PEXT. The tables are filled during static initialization of
+// Attacks.cpp so they must not be used from other static initializers.
+struct SlidingAttackEntry {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard const* attacks;
+    std::uint8_t shift;
+};
+
+extern SlidingAttackEntry rookAttackEntries[64];
+extern SlidingAttackEntry bishopAttackEntries[64];
+extern bool const slidingAttacksUsePext;
+
+#if CHESS_ENGINE_PEXT_AVAILABLE
+Bitboard pextAttackLookup(SlidingAttackEntry const& entry, Bitboard occupancy);
+#endif
+
+inline Bitboard slidingAttackLookup(SlidingAttackEntry const& entry, Bitboard occupancy) {
+#if CHESS_ENGINE_PEXT_AVAILABLE
+    if (slidingAttacksUsePext) {
+        return pextAttackLookup(entry, occupancy);
+    }
+#endif
+    return entry.attacks[((occupancy & entry.mask) * entry.magic) >> entry.shift];
+}
+
+// squares attacked from square given the occupancy, including the first blocker in each direction
+inline Bitboard rookAttacks(std::uint8_t square, Bitboard occupancy) {
+    return slidingAttackLookup(rookAttackEntries[square], occupancy);
+}
+
+inline Bitboard bishopAttacks(std::uint8_t square, Bitboard occupancy) {
+    return slidingAttackLookup(bishopAttackEntries[square], occupancy);
+}
+
+inline Bitboard queenAttacks(std::uint8_t square, Bitboard occupancy) {
+    return rookAttacks(square, occupancy) | bishopAttacks(square, occupancy);
+}
+
+namespace detail {
+
+using StepDirections = std::array<std::array<int, 2>, 8>;
+
+constexpr StepDirections knight_steps {{{-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1}}};
+constexpr StepDirections king_steps {{{-1,-1},{-1,0},{-1,1},{0,-1},{0,1},{1,-1},{1,0},{1,1}}};
+
+constexpr bool on_board(int col, int row) {
+    return col >= 0 && col < 8 && row >= 0 && row < 8;
+}
+
+// only the first count directions are used
+constexpr std::array<Bitboard, 64> makeStepAttackTable(StepDirections const& directions, std::size_t count) {
+    std::array<Bitboard, 64> table {};
+    for (int square = 0; square < 64; square++) {
+        for (std::size_t i = 0; i < count; i++) {
+            int col = square % 8 + directions[i][0];
+            int row = square / 8 + directions[i][1];
+            if (on_board(col, row)) {
+                table[square] |= Bitboard {1} << (row * 8 + col);
+            }
+        }
+    }
+    return table;
+}
+
+struct LineTables {
+    std::array<std::array<Bitboard, 64>, 64> between;
+    std::array<std::array<Bitboard, 64>, 64> line;
+};
+
+// squares from square in direction, not including square itself
+constexpr Bitboard ray(int square, std::array<int, 2> const& direction) {
+    Bitboard result = 0;
+    int col = square % 8 + direction[0];
+    int row = square / 8 + direction[1];
+    while (on_board(col, row)) {
+        result |= Bitboard {1} << (row * 8 + col);
+        col += direction[0];
+        row += direction[1];
+    }
+    return result;
+}
+
+constexpr LineTables makeLineTables() {
+    LineTables tables {};
+    for (int a = 0; a < 64; a++) {
+        for (auto const& direction: king_steps) {
+            Bitboard full_line = (Bitboard {1} << a) | ray(a, direction) | ray(a, {-direction[0], -direction[1]});
+            Bitboard passed = 0;
+            int col = a % 8 + direction[0];
+            int row = a / 8 + direction[1];
+            while (on_board(col, row)) {
+                int b = row * 8 + col;
+                tables.line[a][b] = full_line;
+                tables.between[a][b] = passed;
+                passed |= Bitboard {1} << b;
+                col += direction[0];
+                row += direction[1];
+            }
+        }
+    }
+    return tables;
+}
+
+}
+
+// Tables for everything which does not depend on occupancy are built at compile time
+inline constexpr std::array<Bitboard, 64> knightAttackTable = detail::makeStepAttackTable(detail::knight_steps, 8);
+inline constexpr std::array<Bitboard, 64> kingAttackTable = detail::makeStepAttackTable(detail::king_steps, 8);
+// indexed by [color][square]
+inline constexpr std::array<std::array<Bitboard, 64>, 2> pawnAttackTable {
+    detail::makeStepAttackTable({{{-1,-1}, {1,-1}}}, 2),
+    detail::makeStepAttackTable({{{-1,1}, {1,1}}}, 2),
+};
+inline constexpr detail::LineTables lineTables = detail::makeLineTables();
+
+constexpr Bitboard knightAttacks(std::uint8_t square) {
+    return knightAttackTable[square];
+}
+
+constexpr Bitboard kingAttacks(std::uint8_t square) {
+    return kingAttackTable[square];
+}
+
+// squares a pawn of color on square captures on, regardless of what is there
+constexpr Bitboard pawnAttacks(Color color, std::uint8_t square) {
+    return pawnAttackTable[color][square];
+}
+
+// squares strictly between a and b, empty unless they share a rank, file or diagonal
+constexpr Bitboard betweenSquares(std::uint8_t a, std::uint8_t b) {
+    return lineTables.between[a][b];
+}
+
+// the whole rank, file or diagonal through a and b including both, empty if there is none
+constexpr Bitboard lineThrough(std::uint8_t a, std::uint8_t b) {
+    return lineTables.line[a][b];
+}
+
+static_assert(knightAttacks(0) == 0x20400ull, "knight on a1 attacks b3 and c2");
+static_assert(pawnAttacks(Color::White, 12) == 0x280000ull, "white pawn on e2 attacks d3 and f3");
+static_assert(betweenSquares(0, 63) == 0x0040201008040200ull, "a1 to h8 diagonal");
+static_assert(lineThrough(0, 7) == 0xFFull, "first rank");
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace ChessEngineLib {
+
+struct ZobristKeys {
+    // indexed by [color * 6 + type][square index], same as Board::m_pieces
+    std::array<std::array<std::uint64_t, 64>, 12> pieces;
+    std::uint64_t whiteToMove;
+    // whiteQueenSide, whiteKingSide, blackQueenSide, blackKingSide
+    std::array<std::uint64_t, 4> castling;
+    // en passant square is identified by its column, the row follows from the side to move
+    std::array<std::uint64_t, 8> enPassantCol;
+    // indexed by [color * 6 + type][n], in the material key while there are more than n such pieces
+    std::array<std::array<std::uint64_t, 64>, 12> material;
+};
+
+namespace detail {
+
+constexpr std::uint64_t splitmix64(std::uint64_t& state) {
+    state += 0x9E3779B97F4A7C15ull;
+    std::uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys makeZobristKeys() {
+    std::uint64_t state = 0x5EED0C4E55ull;
+    ZobristKeys keys {};
+    for (auto& piece_keys: keys.pieces) {
+        for (auto& key: piece_keys) {
+            key = splitmix64(state);
+        }
+    }
+    keys.whiteToMove = splitmix64(state);
+    for (auto& key: keys.castling) {
+        key = splitmix64(state);
+    }
+    for (auto& key: keys.enPassantCol) {
+        key = splitmix64(state);
+    }
+    for (auto& count_keys: keys.material) {
+        for (auto& key: count_keys) {
+            key = splitmix64(state);
+        }
+    }
+    return keys;
+}
+
+}
+
+// fixed at compile time so hashes are stable across runs and can be stored
+inline constexpr ZobristKeys zobristKeys = detail::makeZobristKeys();
+
+}
+
+#endif
@@ -67,3 +67,22 @@ TEST_F(AiPlayerTestFixture, random_move_player_can_play_long_games) {
     LOG(INFO) << "Played the following game using random moves only";
     LOG(INFO) << game.toPgn();
 }
+
+TEST_F(AiPlayerTestFixture, random_move_player_with_cache_only_plays_legal_moves) {
+    LegalMoveCache cache {64};
+    RandomMovePlayer rmp {&cache};
+    for (int i = 0; i < 5; i++) {
+        Game game {};
+        while (!game.result().has_value()) {
+            std::optional<Move> move_opt = rmp.getMove(game.board());
+            ASSERT_TRUE(move_opt.has_value());
+            ASSERT_TRUE(game.makeMove(move_opt.value())) << move_opt.value() << " in " << game.board();
+        }
+    }
+    // random games may evict any position, asking twice in a row always hits
+    std::uint64_t const hits_before = cache.hits();
+    Board const board = Board::startingPosBoard();
+    ASSERT_TRUE(rmp.getMove(board).has_value());
+    ASSERT_TRUE(rmp.getMove(board).has_value());
+    EXPECT_GT(cache.hits(), hits_before);
+}
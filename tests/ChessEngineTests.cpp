@@ -1,10 +1,17 @@
 #include <gtest/gtest.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <array>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "ChessEngineLib/GameEngine.hpp"
 #include "ChessEngineLib/Board.hpp"
+#include "ChessEngineLib/LegalMoveCache.hpp"
 #include "ChessEngineLib/Move.hpp"
+#include "ChessEngineLib/MovePicker.hpp"
+#include "ChessEngineLib/PackedMove.hpp"
 
 GTEST_API_ int main(int argc, char **argv) {
     printf("Running main() from ChessEngineTests.cpp\n");
@@ -66,7 +73,22 @@ TEST_F(EngineTestFixture, assert_validation_of_fen_works_correctly) {
 
 TEST_F(EngineTestFixture, construct_correct_board_from_invalid_fens_should_fail) {
     std::vector<std::string> invalidFens {
-		"", "hello", "\n", "\twhat\n"
+		"", "hello", "\n", "\twhat\n",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR  w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR/8 w KQkq - 0 1",
+        "rnbqkbnr/ppppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/44p/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/7/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkx - 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e9 0 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - -1 1",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1x",
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 99999999999999999999999",
 	};
     for (const auto& fen : invalidFens) {
         EXPECT_FALSE(Board::fromFen(fen).has_value());
@@ -245,6 +267,23 @@ TEST_F(EngineTestFixture, board_to_fen) {
     EXPECT_EQ(fen6, board6.fen());
 }
 
+TEST_F(EngineTestFixture, write_fen_into_caller_buffer) {
+    std::string fen = "rn1qk2r/5ppp/4pn2/pPpp1b2/1b1P1B2/4PN1P/PP2KPP1/RN1Q1B1R w kq a6 0 9";
+    Board board = Board::fromFen(std::string_view(fen)).value();
+    std::array<char, Board::maxFenLength> buffer;
+    char* end = board.writeFen(buffer.data(), buffer.data() + buffer.size());
+    ASSERT_NE(nullptr, end);
+    EXPECT_EQ(fen, std::string_view(buffer.data(), static_cast<std::size_t>(end - buffer.data())));
+
+    // exactly enough room works, one character less doesnt
+    EXPECT_EQ(buffer.data() + fen.size(), board.writeFen(buffer.data(), buffer.data() + fen.size()));
+    EXPECT_EQ(nullptr, board.writeFen(buffer.data(), buffer.data() + fen.size() - 1));
+
+    std::string big_numbers = "8/8/8/8/8/8/8/K6k b - - 18446744073709551615 18446744073709551615";
+    board = Board::fromFen(big_numbers).value();
+    EXPECT_EQ(big_numbers, board.fen());
+}
+
 TEST_F(EngineTestFixture, equality_operator_for_boards) {
     Board board1 = Board::fromFen("rn1qk2r/5ppp/4pn2/pPpp1b2/1b1P1B2/4PN1P/PP2KPP1/RN1Q1B1R w kq a6 0 9").value();
     Board board2 = Board::fromFen("rn1qk2r/5ppp/4pn2/pPpp1b2/1b1P1B2/4PN1P/PP2KPP1/RN1Q1B1R w kq a6 0 9").value();
@@ -388,3 +427,527 @@ TEST_F(EngineTestFixture, result_from_board_position) {
     }
 }
 
+
+TEST_F(EngineTestFixture, insufficient_material_is_a_draw) {
+    std::array dead_fens = {
+        "8/8/4k3/8/8/3K4/8/8 w - - 0 1",
+        "8/8/4k3/8/8/3K4/5N2/8 b - - 0 1",
+        "8/8/4kb2/8/8/3K4/8/8 w - - 0 1",
+        // bishops all on light squares, whoever owns them
+        "8/8/4k3/1b6/8/3K4/2B5/5B2 w - - 0 1",
+    };
+    for (auto const& fen: dead_fens) {
+        Board board = Board::fromFen(fen).value();
+        EXPECT_TRUE(board.isInsufficientMaterial()) << "for fen: " << fen;
+        EXPECT_EQ(std::optional<ResultType>(ResultType::Draw), isGameOver(board)) << "for fen: " << fen;
+    }
+    std::array live_fens = {
+        "8/8/4k3/8/8/3K4/4P3/8 w - - 0 1",
+        "8/8/4k3/8/8/3K4/4NN2/8 w - - 0 1",
+        "8/8/4kn2/8/8/3K4/4B3/8 w - - 0 1",
+        "8/8/4kb2/8/8/3K4/4B3/8 w - - 0 1",
+        "8/8/4k3/8/8/3K4/4R3/8 w - - 0 1",
+    };
+    for (auto const& fen: live_fens) {
+        Board board = Board::fromFen(fen).value();
+        EXPECT_FALSE(board.isInsufficientMaterial()) << "for fen: " << fen;
+        EXPECT_EQ(std::nullopt, isGameOver(board)) << "for fen: " << fen;
+    }
+}
+
+TEST_F(EngineTestFixture, material_key_depends_only_on_material) {
+    Board board = Board::startingPosBoard();
+    Board moved = board;
+    ASSERT_TRUE(makeMove(moved, Move({6,0}, {5,2})));
+    EXPECT_EQ(board.materialKey(), moved.materialKey());
+    EXPECT_EQ(8, board.pieceCount(Color::White, Piece::Type::Pawn));
+    EXPECT_EQ(1, board.pieceCount(Color::Black, Piece::Type::Queen));
+
+    // a capture and then a promotion change it, and it always matches a board set up from scratch
+    Board promotion = Board::fromFen("r3k3/1P6/8/8/8/8/8/4K3 w - - 0 1").value();
+    std::uint64_t before = promotion.materialKey();
+    Board::UndoInfo undo = promotion.makeMove(Move({1,6}, {0,7}, Piece::Type::Queen));
+    EXPECT_NE(before, promotion.materialKey());
+    EXPECT_EQ(Board::fromFen("Q3k3/8/8/8/8/8/8/4K3 b - - 0 1").value().materialKey(), promotion.materialKey());
+    EXPECT_EQ(Board::fromFen("4k3/8/8/8/8/8/8/Q3K3 b - - 0 1").value().materialKey(), promotion.materialKey());
+    promotion.unmakeMove(Move({1,6}, {0,7}, Piece::Type::Queen), undo);
+    EXPECT_EQ(before, promotion.materialKey());
+    EXPECT_NE(Board::fromFen("4k3/8/8/8/8/8/8/4K3 w - - 0 1").value().materialKey(), before);
+}
+
+TEST_F(EngineTestFixture, gives_check_matches_playing_the_move) {
+    std::array fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        // discovered check by en passant, the captured pawn was the only blocker
+        "8/8/8/1k1pP2R/8/8/8/4K3 w - d6 0 1",
+        // castling with the rook landing on the king's file
+        "5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+        "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",
+        // promotion checking along the file the pawn just left
+        "8/4P3/8/8/8/8/8/2K1k3 w - - 0 1",
+        // discovered check by a piece moving off the line
+        "4k3/8/8/8/4N3/8/8/4R1K1 w - - 0 1",
+    };
+    for (auto const& fen: fens) {
+        Board board = Board::fromFen(fen).value();
+        MoveList moves;
+        generateLegalMoves(board, moves);
+        for (Move const& move: moves) {
+            Board after = board;
+            after.forceMakeMove(move);
+            bool in_check = isSquareAttacked(after, after.kingSquare(after.getNextMoveColor()).value(), board.getNextMoveColor());
+            EXPECT_EQ(in_check, givesCheck(board, move)) << "for fen: " << fen << " and move " << move;
+        }
+    }
+}
+
+TEST_F(EngineTestFixture, parse_san_resolves_the_moving_piece) {
+    auto parse = [](std::string_view fen, std::string_view san) {
+        return parseSan(Board::fromFen(fen).value(), san);
+    };
+    std::string_view start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    EXPECT_EQ(Move({4,1}, {4,3}), parse(start, "e4"));
+    EXPECT_EQ(Move({6,0}, {5,2}), parse(start, "Nf3"));
+    EXPECT_EQ(std::nullopt, parse(start, "e5"));
+    EXPECT_EQ(std::nullopt, parse(start, "Qh5"));
+    EXPECT_EQ(std::nullopt, parse(start, "Ke2"));
+    EXPECT_EQ(std::nullopt, parse(start, "O-O"));
+    EXPECT_EQ(Move({4,6}, {4,4}), parse("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", "e5"));
+
+    std::string_view kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    EXPECT_EQ(Move({4,0}, {6,0}), parse(kiwipete, "O-O"));
+    EXPECT_EQ(Move({4,0}, {2,0}), parse(kiwipete, "O-O-O+"));
+    EXPECT_EQ(Move({4,4}, {3,6}), parse(kiwipete, "Nxd7"));
+    EXPECT_EQ(Move({5,2}, {7,2}), parse(kiwipete, "Qxh3!?"));
+    EXPECT_EQ(Move({4,1}, {0,5}), parse(kiwipete, "Bxa6"));
+    EXPECT_EQ(Move({3,4}, {4,5}), parse(kiwipete, "dxe6"));
+
+    // disambiguation by file and by rank
+    std::string_view knights = "4k3/8/8/8/8/8/2N1N3/4K3 w - - 0 1";
+    EXPECT_EQ(std::nullopt, parse(knights, "Nd4"));
+    EXPECT_EQ(Move({2,1}, {3,3}), parse(knights, "Ncd4"));
+    EXPECT_EQ(Move({4,1}, {3,3}), parse(knights, "Ned4"));
+    std::string_view rooks = "4k3/8/8/R7/8/8/8/R3K3 w - - 0 1";
+    EXPECT_EQ(std::nullopt, parse(rooks, "Ra3"));
+    EXPECT_EQ(Move({0,0}, {0,2}), parse(rooks, "R1a3"));
+    EXPECT_EQ(Move({0,4}, {0,2}), parse(rooks, "R5a3"));
+    // the pinned knight isnt a candidate so no disambiguation is written
+    EXPECT_EQ(Move({2,1}, {3,3}), parse("4k3/8/8/8/4r3/8/2N1N3/4K3 w - - 0 1", "Nd4"));
+    // and naming it doesnt make its move legal
+    EXPECT_EQ(std::nullopt, parse("4k3/8/8/8/4r3/8/2N1N3/4K3 w - - 0 1", "Ned4"));
+    EXPECT_EQ(std::nullopt, parse("4k3/8/8/8/4r3/8/4N3/4K3 w - - 0 1", "Nd4"));
+
+    std::string_view promotion = "8/4P3/8/8/8/8/8/2K1k3 w - - 0 1";
+    EXPECT_EQ(Move({4,6}, {4,7}, Piece::Type::Queen), parse(promotion, "e8=Q"));
+    EXPECT_EQ(Move({4,6}, {4,7}, Piece::Type::Knight), parse(promotion, "e8N+"));
+    EXPECT_EQ(std::nullopt, parse(promotion, "e8"));
+    EXPECT_EQ(std::nullopt, parse(promotion, "e8=K"));
+    EXPECT_EQ(Move({4,4}, {3,5}), parse("8/8/8/1k1pP2R/8/8/8/4K3 w - d6 0 1", "exd6"));
+
+    for (std::string_view san: {"", "e", "Z4", "Nz9", "e4e5", "Nf3x", "Rxa9"}) {
+        EXPECT_EQ(std::nullopt, parse(start, san)) << "for san " << san;
+    }
+}
+
+TEST_F(EngineTestFixture, san_disambiguation_from_attackers) {
+    auto disambiguation = [](std::string_view fen, Move const& move) {
+        return sanDisambiguation(Board::fromFen(fen).value(), move);
+    };
+    std::string_view knights = "4k3/8/8/8/8/8/2N1N3/4K3 w - - 0 1";
+    EXPECT_EQ(std::make_pair(true, false), disambiguation(knights, Move({2,1}, {3,3})));
+    EXPECT_EQ(std::make_pair(false, false), disambiguation(knights, Move({2,1}, {1,3})));
+    // a pinned knight doesnt count
+    EXPECT_EQ(std::make_pair(false, false), disambiguation("4k3/8/8/8/4r3/8/2N1N3/4K3 w - - 0 1", Move({2,1}, {3,3})));
+    // neither does a rook whose way is blocked
+    std::string_view rooks = "4k3/8/8/R7/8/8/8/R3K3 w - - 0 1";
+    EXPECT_EQ(std::make_pair(false, true), disambiguation(rooks, Move({0,0}, {0,2})));
+    EXPECT_EQ(std::make_pair(false, false), disambiguation(rooks, Move({0,4}, {0,5})));
+    std::string_view queens = "4k3/8/8/8/Q6Q/8/8/4K2Q w - - 0 1";
+    EXPECT_EQ(std::make_pair(true, true), disambiguation(queens, Move({7,3}, {4,3})));
+    EXPECT_EQ(std::make_pair(true, false), disambiguation(queens, Move({0,3}, {4,3})));
+    // pawns and kings never need it
+    EXPECT_EQ(std::make_pair(false, false), disambiguation("4k3/8/8/3p4/2P1P3/8/8/4K3 w - - 0 1", Move({2,3}, {3,4})));
+}
+
+TEST_F(EngineTestFixture, upcoming_repetition_needs_a_clear_path_back) {
+    auto upcoming = [](std::string_view earlier_fen, std::string_view fen) {
+        Board earlier = Board::fromFen(earlier_fen).value();
+        Board board = Board::fromFen(fen).value();
+        // the two positions in between dont matter
+        return hasUpcomingRepetition(board, {earlier.hash(), 1, 2, board.hash()});
+    };
+    EXPECT_TRUE(upcoming("4k3/8/8/2b5/8/8/8/4K3 w - - 5 40", "4k3/8/8/8/8/b7/8/4K3 b - - 8 41"));
+    EXPECT_FALSE(upcoming("4k3/8/8/2b5/1P6/8/8/4K3 w - - 5 40", "4k3/8/8/8/1P6/b7/8/4K3 b - - 8 41"));
+    // the bishop would have to move for the side which isnt to move
+    EXPECT_FALSE(upcoming("4k3/8/8/2b5/8/8/8/4K3 b - - 5 40", "4k3/8/8/8/8/b7/8/4K3 w - - 8 41"));
+    // there was a capture or pawn move since
+    EXPECT_FALSE(upcoming("4k3/8/8/2b5/8/8/8/4K3 w - - 5 40", "4k3/8/8/8/8/b7/8/4K3 b - - 2 41"));
+}
+
+TEST_F(EngineTestFixture, has_any_legal_move_agrees_with_move_generation) {
+    std::array fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r5kr/5p1p/pqN2p1B/1pp5/8/1PPP2R1/1P3PPP/R5K1 b - - 5 3",
+        "k7/8/8/8/8/4B3/1R2K3/8 b - - 1 1",
+        "8/k1N5/8/1R1K4/8/8/8/8 b - - 6 10",
+        // double check, only the king can move
+        "4k3/8/8/8/1b6/8/3N4/r3K3 w - - 0 1",
+        // the only legal move is an en passant capture
+        "8/8/8/1Pp5/1K6/8/8/7k w - c6 0 1",
+        // stalemates
+        "8/8/8/8/8/k7/p7/K7 w - - 0 1",
+        "7k/8/8/8/8/8/1q6/K7 w - - 0 1",
+    };
+    for (auto const& fen: fens) {
+        Board board = Board::fromFen(fen).value();
+        MoveList moves;
+        generateLegalMoves(board, moves);
+        EXPECT_EQ(!moves.empty(), hasAnyLegalMove(board)) << "for fen: " << fen;
+    }
+}
+
+TEST_F(EngineTestFixture, bitboards_agree_with_grid_view) {
+    Board board = Board::fromFen("rn1qk2r/5ppp/4pn2/pPpp1b2/1b1P1B2/4PN1P/PP2KPP1/RN1Q1B1R w kq a6 0 9").value();
+    EXPECT_EQ(16, popCount(board.occupancy(Color::White)));
+    EXPECT_EQ(15, popCount(board.occupancy(Color::Black)));
+    EXPECT_EQ(squareBit(Square {4,1}), board.pieces(Color::White, Piece::Type::King));
+    EXPECT_EQ(squareBit(Square {1,7}) | squareBit(Square {5,5}), board.pieces(Color::Black, Piece::Type::Knight));
+    for (std::uint8_t col=0; col<8; col++) {
+        for (std::uint8_t row=0; row<8; row++) {
+            Square square {col, row};
+            std::optional<Piece> piece = board.grid()[col][row];
+            EXPECT_EQ(piece, board.at(square)) << "for square " << square;
+            EXPECT_EQ(piece.has_value(), (board.occupancy() & squareBit(square)) != 0) << "for square " << square;
+            if (piece.has_value()) {
+                EXPECT_TRUE(board.pieces(piece.value().color, piece.value().type) & squareBit(square)) << "for square " << square;
+            }
+        }
+    }
+
+    Board after = board;
+    after.forceMakeMove(Move({1,4}, {0,5}));
+    EXPECT_FALSE(after.at({0,4}).has_value());
+    EXPECT_EQ(white_pawn, after.at({0,5}).value());
+    EXPECT_EQ(14, popCount(after.occupancy(Color::Black)));
+}
+
+TEST_F(EngineTestFixture, piece_squares_and_king_square_follow_moves) {
+    Board board = Board::startingPosBoard();
+    std::vector<Square> knights(board.pieceSquares(Color::White, Piece::Type::Knight).begin(),
+        board.pieceSquares(Color::White, Piece::Type::Knight).end());
+    EXPECT_EQ((std::vector<Square> {{1,0}, {6,0}}), knights);
+    EXPECT_EQ(Square({4,7}), board.kingSquare(Color::Black));
+    EXPECT_EQ(std::optional<Piece::Type>(Piece::Type::Queen), board.typeAt(Color::White, squareIndex({3,0})));
+    EXPECT_EQ(std::nullopt, board.typeAt(Color::Black, squareIndex({3,0})));
+
+    ASSERT_TRUE(makeMove(board, Move({4,1}, {4,3})));
+    ASSERT_TRUE(makeMove(board, Move({4,6}, {4,4})));
+    ASSERT_TRUE(makeMove(board, Move({4,0}, {4,1})));
+    EXPECT_EQ(Square({4,1}), board.kingSquare(Color::White));
+    std::size_t pawns = 0;
+    for (Square square: board.pieceSquares(Color::Black, Piece::Type::Pawn)) {
+        EXPECT_EQ(Piece(Piece::Type::Pawn, Color::Black), board.at(square));
+        pawns++;
+    }
+    EXPECT_EQ(8u, pawns);
+
+    EXPECT_EQ(std::nullopt, Board::fromFen("8/8/8/8/8/8/8/K7 w - - 0 1").value().kingSquare(Color::Black));
+}
+
+TEST_F(EngineTestFixture, legal_move_cache_returns_generated_moves_and_stays_bounded) {
+    // small enough that walking the tree below has to evict
+    LegalMoveCache cache {8};
+    EXPECT_EQ(8u, cache.capacity());
+    Board root = Board::fromFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1").value();
+    MoveList root_moves;
+    generateLegalMoves(root, root_moves);
+    for (int pass = 0; pass < 2; pass++) {
+        for (Move const& move: root_moves) {
+            Board board = root;
+            board.forceMakeMove(move);
+            MoveList expected;
+            generateLegalMoves(board, expected);
+            MoveList cached;
+            cache.legalMoves(board, cached);
+            ASSERT_EQ(expected.size(), cached.size()) << "after " << move;
+            for (std::size_t i = 0; i < expected.size(); i++) {
+                EXPECT_EQ(expected.packed(i), cached.packed(i));
+            }
+        }
+    }
+    EXPECT_EQ(2 * root_moves.size(), cache.hits() + cache.misses());
+    EXPECT_LT(cache.hits(), root_moves.size());
+
+    MoveList moves;
+    cache.legalMoves(root, moves);
+    moves.clear();
+    cache.legalMoves(root, moves);
+    EXPECT_EQ(root_moves.size(), moves.size());
+    std::uint64_t hits = cache.hits();
+    EXPECT_GT(hits, 0u);
+    cache.clear();
+    EXPECT_EQ(0u, cache.hits());
+    EXPECT_EQ(0u, cache.misses());
+}
+
+TEST_F(EngineTestFixture, move_list_generation_matches_legal_move_set) {
+    std::unordered_map<std::string, std::size_t> expected_move_counts = {
+        {starting_position_fen, 20},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 48},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 14},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 6},
+    };
+    for (auto const& [fen, expected_count]: expected_move_counts) {
+        Board board = Board::fromFen(fen).value();
+        MoveList moves;
+        generateLegalMoves(board, moves);
+        EXPECT_EQ(expected_count, moves.size()) << "for fen: " << fen;
+        std::unordered_set<Move> move_set = getAllLegalMoves(board);
+        EXPECT_EQ(move_set.size(), moves.size()) << "for fen: " << fen;
+        for (Move const& move: moves) {
+            EXPECT_TRUE(move_set.count(move)) << "for fen: " << fen << " and move " << move;
+        }
+    }
+}
+
+TEST_F(EngineTestFixture, slider_destinations_stop_at_first_blocker) {
+    Board board = Board::fromFen("4k3/1p4b1/8/8/1R1Q2n1/8/8/3K4 w - - 0 1").value();
+    std::unordered_set<Square> expected_queen_destinations = {
+        {2,3},{4,3},{5,3},{6,3}, // rank, own rook on b4 and knight on g4
+        {3,1},{3,2},{3,4},{3,5},{3,6},{3,7}, // file, own king on d1
+        {2,2},{1,1},{0,0},{4,2},{5,1},{6,0}, // lower diagonals
+        {2,4},{1,5},{0,6},{4,4},{5,5},{6,6}, // upper diagonals, captures bishop on g7
+    };
+    EXPECT_EQ(expected_queen_destinations, generatePseudoLegalDestinations(board, {3,3}));
+    std::unordered_set<Square> expected_rook_destinations = {
+        {0,3},{2,3},{1,0},{1,1},{1,2},{1,4},{1,5},{1,6}
+    };
+    EXPECT_EQ(expected_rook_destinations, generatePseudoLegalDestinations(board, {1,3}));
+}
+
+TEST_F(EngineTestFixture, king_cannot_castle_out_of_or_through_check) {
+    // bishop on a6 covers e2 and f1, so no kingside castling but queenside is fine
+    Board board = Board::fromFen("r3k2r/8/b7/8/8/8/8/R3K2R w KQkq - 0 1").value();
+    std::unordered_set<Square> expected_destinations = {{3,0},{3,1},{5,1},{2,0}};
+    EXPECT_EQ(expected_destinations, generateLegalDestinations(board, {4,0}));
+    EXPECT_FALSE(isMoveLegal(board, Move({4,0}, {6,0})));
+
+    // rook on e1 gives check, neither side may castle
+    board = Board::fromFen("r3k2r/8/8/8/8/8/8/4R1K1 b kq - 0 1").value();
+    expected_destinations = {{3,7},{3,6},{5,7},{5,6}};
+    EXPECT_EQ(expected_destinations, generateLegalDestinations(board, {4,7}));
+    EXPECT_TRUE(isSquareAttacked(board, {4,7}, Color::White));
+    EXPECT_FALSE(isSquareAttacked(board, {3,7}, Color::White));
+    EXPECT_EQ(squareBit(Square {4,0}) | squareBit(Square {0,7}) | squareBit(Square {7,7}), attackersTo(board, {4,7}));
+}
+
+TEST_F(EngineTestFixture, pinned_pieces_and_en_passant_do_not_expose_the_king) {
+    // bishop on e2 is pinned by the rook on e7 and cannot move at all
+    Board board = Board::fromFen("4k3/4r3/8/8/8/8/4B3/4K3 w - - 0 1").value();
+    EXPECT_TRUE(generateLegalDestinations(board, {4,1}).empty());
+
+    // a pinned rook can still move along the pin and capture the pinner
+    board = Board::fromFen("4k3/4r3/8/8/8/8/4R3/4K3 w - - 0 1").value();
+    std::unordered_set<Square> expected_destinations = {{4,2},{4,3},{4,4},{4,5},{4,6}};
+    EXPECT_EQ(expected_destinations, generateLegalDestinations(board, {4,1}));
+
+    // capturing en passant would remove both pawns from the fifth rank and expose the king to the rook
+    board = Board::fromFen("8/8/8/KPp4r/8/8/8/7k w - c6 0 1").value();
+    expected_destinations = {{1,5}};
+    EXPECT_EQ(expected_destinations, generateLegalDestinations(board, {1,4}));
+    EXPECT_FALSE(isMoveLegal(board, Move({1,4}, {2,5})));
+    EXPECT_FALSE(makeMove(board, Move({1,4}, {2,5})));
+
+    // the same capture is fine, and the only way out of check, when the pawn that just moved gives check
+    board = Board::fromFen("8/8/8/1Pp5/1K6/8/8/7k w - c6 0 1").value();
+    EXPECT_TRUE(isMoveLegal(board, Move({1,4}, {2,5})));
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    EXPECT_TRUE(moves.contains(Move({1,4}, {2,5})));
+    EXPECT_FALSE(moves.contains(Move({1,4}, {1,5})));
+}
+
+TEST_F(EngineTestFixture, unmake_move_restores_board_after_every_legal_move) {
+    std::vector<std::string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/Pp2P3/2N2Q1p/1PPBBPPP/R3K2R b KQkq a3 0 1",
+    };
+    for (std::string const& fen: fens) {
+        Board board = Board::fromFen(fen).value();
+        Board const original = board;
+        MoveList moves;
+        generateLegalMoves(board, moves);
+        for (Move const& move: moves) {
+            Board::UndoInfo undo = board.makeMove(move);
+            Board expected = original;
+            expected.forceMakeMove(move);
+            EXPECT_EQ(expected, board) << "for fen: " << fen << " and move " << move;
+            board.unmakeMove(move, undo);
+            EXPECT_EQ(original, board) << "for fen: " << fen << " and move " << move;
+            EXPECT_EQ(original.occupancy(), board.occupancy()) << "for fen: " << fen << " and move " << move;
+        }
+    }
+}
+
+TEST_F(EngineTestFixture, castling_rights_only_expire_from_rook_home_corners) {
+    // a rook leaving a4 is on the a-file but not on a1, so white keeps queen side castling
+    Board board = Board::fromFen("r3k2r/8/8/8/R7/8/8/R3K2R w KQkq - 0 1").value();
+    Board const original = board;
+    Board::UndoInfo undo = board.makeMove(Move({0,3}, {1,3}));
+    EXPECT_EQ("r3k2r/8/8/8/1R6/8/8/R3K2R b KQkq - 1 1", board.fen());
+    EXPECT_EQ(Board::fromFen(board.fen()).value().hash(), board.hash());
+    board.unmakeMove(Move({0,3}, {1,3}), undo);
+    EXPECT_EQ(original, board);
+
+    // capturing the rook on a8 does take black's queen side castling
+    undo = board.makeMove(Move({0,3}, {0,7}));
+    EXPECT_EQ("R3k2r/8/8/8/8/8/8/R3K2R b KQk - 0 1", board.fen());
+    board.unmakeMove(Move({0,3}, {0,7}), undo);
+    EXPECT_EQ(original, board);
+
+    // capturing a promoted black rook on a1 leaves black's castling alone
+    board = Board::fromFen("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1").value();
+    board.forceMakeMove(Move({6,0}, {7,0}));
+    board.forceMakeMove(Move({1,1}, {0,0}, Piece::Type::Rook));
+    Board const before_capture = board;
+    undo = board.makeMove(Move({3,0}, {0,0}));
+    EXPECT_EQ("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/P2P2PP/Q4R1K b kq - 0 2", board.fen());
+    EXPECT_EQ(Board::fromFen(board.fen()).value().hash(), board.hash());
+    board.unmakeMove(Move({3,0}, {0,0}), undo);
+    EXPECT_EQ(before_capture, board);
+}
+
+TEST_F(EngineTestFixture, incremental_hash_matches_hash_of_same_position_from_fen) {
+    Board board = Board::startingPosBoard();
+    std::vector<Move> moves = {
+        Move({4,1}, {4,3}), Move({3,6}, {3,4}), Move({4,3}, {3,4}), Move({6,7}, {5,5}),
+        Move({5,0}, {1,4}), Move({2,6}, {2,5}), Move({3,4}, {2,5}), Move({3,7}, {1,5}),
+        Move({2,5}, {1,6}), Move({1,7}, {3,6}), Move({6,0}, {5,2}), Move({4,6}, {4,4}),
+    };
+    for (Move const& move: moves) {
+        ASSERT_TRUE(makeMove(board, move)) << move;
+        EXPECT_EQ(Board::fromFen(board.fen()).value().hash(), board.hash()) << "after move " << move;
+    }
+    EXPECT_EQ(std::hash<Board>{}(board), static_cast<std::size_t>(board.hash()));
+
+    // same pieces reached through different move orders
+    Board a = Board::startingPosBoard();
+    Board b = Board::startingPosBoard();
+    for (Move const& move: {Move({6,0}, {5,2}), Move({6,7}, {5,5}), Move({1,0}, {2,2})}) {
+        a.forceMakeMove(move);
+    }
+    for (Move const& move: {Move({1,0}, {2,2}), Move({6,7}, {5,5}), Move({6,0}, {5,2})}) {
+        b.forceMakeMove(move);
+    }
+    EXPECT_EQ(a.hash(), b.hash());
+
+    // side to move, castling rights and en passant are all part of the key
+    std::string const fen = "r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq d6 0 1";
+    std::uint64_t hash = Board::fromFen(fen).value().hash();
+    EXPECT_NE(hash, Board::fromFen("r3k2r/8/8/3pP3/8/8/8/R3K2R b KQkq d6 0 1").value().hash());
+    EXPECT_NE(hash, Board::fromFen("r3k2r/8/8/3pP3/8/8/8/R3K2R w Kkq d6 0 1").value().hash());
+    EXPECT_NE(hash, Board::fromFen("r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq - 0 1").value().hash());
+    EXPECT_EQ(hash, Board::fromFen("r3k2r/8/8/3pP3/8/8/8/R3K2R w KQkq d6 7 30").value().hash());
+}
+
+TEST_F(EngineTestFixture, packed_move_round_trips_and_records_kind) {
+    for (std::uint8_t from = 0; from < 64; from++) {
+        for (std::uint8_t to = 0; to < 64; to++) {
+            Move move(squareAt(from), squareAt(to));
+            EXPECT_EQ(move, PackedMove(move).toMove());
+            for (Piece::Type type: {Piece::Type::Knight, Piece::Type::Bishop, Piece::Type::Rook, Piece::Type::Queen}) {
+                Move promotion(squareAt(from), squareAt(to), type);
+                EXPECT_EQ(promotion, PackedMove(promotion).toMove());
+                EXPECT_NE(PackedMove(move), PackedMove(promotion));
+            }
+        }
+    }
+    static_assert(sizeof(PackedMove) == 2);
+    EXPECT_TRUE(PackedMove {}.isNull());
+
+    // white can castle both ways, capture en passant on d6 and promote on b8
+    Board board = Board::fromFen("4k3/1P6/8/3pP3/8/8/8/R3K2R w KQ d6 0 1").value();
+    MoveList moves;
+    generateLegalMoves(board, moves);
+    std::unordered_map<PackedMove::Kind, std::size_t> kinds {};
+    for (std::size_t i = 0; i < moves.size(); i++) {
+        kinds[moves.packed(i).kind()]++;
+        EXPECT_EQ(moves[i], moves.packed(i).toMove());
+    }
+    EXPECT_EQ(2u, kinds[PackedMove::Kind::Castle]);
+    EXPECT_EQ(1u, kinds[PackedMove::Kind::EnPassant]);
+    EXPECT_EQ(4u, kinds[PackedMove::Kind::Promotion]);
+    EXPECT_TRUE(moves.contains(Move({4,4}, {3,5})));
+    EXPECT_TRUE(moves.contains(Move({1,6}, {1,7}, Piece::Type::Knight)));
+}
+
+TEST_F(EngineTestFixture, move_picker_returns_every_legal_move_once_in_stage_order) {
+    std::vector<std::string> fens = {
+        starting_position_fen,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "8/8/8/KPp4r/8/8/8/7k w - c6 0 1",
+    };
+    for (std::string const& fen: fens) {
+        Board board = Board::fromFen(fen).value();
+        std::unordered_set<Move> expected = getAllLegalMoves(board);
+        MovePicker picker(board);
+        std::vector<Move> picked(picker.begin(), picker.end());
+        EXPECT_EQ(expected.size(), picked.size()) << "for fen: " << fen;
+        EXPECT_EQ(expected, std::unordered_set<Move>(picked.begin(), picked.end())) << "for fen: " << fen;
+        EXPECT_FALSE(picker.next().has_value());
+    }
+
+    // kiwipete: hash move first, then captures with the most valuable victim first, then the killer
+    Board board = Board::fromFen(fens.at(1)).value();
+    Move hash_move({4,0}, {6,0});
+    Move killer({0,1}, {0,3});
+    Move not_legal({0,0}, {0,7});
+    MovePicker picker(board, PackedMove(hash_move), {PackedMove(not_legal), PackedMove(killer)});
+    std::vector<Move> picked(picker.begin(), picker.end());
+    ASSERT_EQ(48u, picked.size());
+    EXPECT_EQ(hash_move, picked.at(0));
+    // bishop takes bishop, then queen takes knight, then the pawn captures before the knight captures
+    EXPECT_EQ(Move({4,1}, {0,5}), picked.at(1));
+    EXPECT_EQ(Move({5,2}, {5,5}), picked.at(2));
+    std::unordered_set<Move> pawn_captures = {Move({3,4}, {4,5}), Move({6,1}, {7,2})};
+    EXPECT_TRUE(pawn_captures.count(picked.at(3)));
+    EXPECT_TRUE(pawn_captures.count(picked.at(4)));
+    std::size_t captures = 8;
+    EXPECT_EQ(killer, picked.at(1 + captures));
+    EXPECT_EQ(1, std::count(picked.begin(), picked.end(), hash_move));
+    EXPECT_EQ(1, std::count(picked.begin(), picked.end(), killer));
+}
+
+TEST_F(EngineTestFixture, move_picker_checks_hash_and_killer_moves_like_the_generator) {
+    // the fifty move rule ends the game but leaves the moves legal for the generator
+    Board board = Board::fromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 60 40").value();
+    Move hash_move({4,1}, {4,3});
+    Move killer({6,0}, {5,2});
+    MovePicker picker(board, PackedMove(hash_move), {PackedMove(killer), PackedMove {}});
+    std::vector<Move> picked(picker.begin(), picker.end());
+    ASSERT_EQ(20u, picked.size());
+    EXPECT_EQ(hash_move, picked.at(0));
+    EXPECT_EQ(killer, picked.at(1));
+    EXPECT_EQ(1, std::count(picked.begin(), picked.end(), hash_move));
+    EXPECT_EQ(1, std::count(picked.begin(), picked.end(), killer));
+
+    // a pawn reaching the last rank has to promote, whether it captures or not
+    board = Board::fromFen("r3k3/1P6/8/8/8/8/8/4K3 w - - 0 1").value();
+    Move no_promotion_capture({1,6}, {0,7});
+    Move no_promotion_push({1,6}, {1,7});
+    EXPECT_FALSE(isPackedMoveLegal(board, PackedMove(no_promotion_capture)));
+    EXPECT_FALSE(isPackedMoveLegal(board, PackedMove(no_promotion_push)));
+    EXPECT_TRUE(isPackedMoveLegal(board, PackedMove(Move({1,6}, {0,7}, Piece::Type::Rook))));
+    MovePicker promotion_picker(board, PackedMove(no_promotion_capture), {PackedMove(no_promotion_push), PackedMove {}});
+    picked.assign(promotion_picker.begin(), promotion_picker.end());
+    std::unordered_set<Move> expected = getAllLegalMoves(board);
+    EXPECT_EQ(expected.size(), picked.size());
+    EXPECT_EQ(expected, std::unordered_set<Move>(picked.begin(), picked.end()));
+    EXPECT_EQ(Move({1,6}, {0,7}, Piece::Type::Queen), picked.at(0));
+}
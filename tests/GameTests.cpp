@@ -148,6 +148,34 @@ Nf2 42. g4 Bd3 43. Re6 1/2-1/2
 }
 
 
+TEST_F(GameTestFixture, moves_made_on_a_game_are_disambiguated_like_the_pgn) {
+    std::string const pgn = R"raw(
+[Event "F/S Return Match"]
+[Result "1/2-1/2"]
+
+1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6
+8. c3 O-O 9. h3 Nb8 10. d4 Nbd7 11. c4 c6 12. cxb5 axb5 13. Nc3 Bb7 14. Bg5 b4
+15. Nb1 h6 16. Bh4 c5 17. dxe5 Nxe4 18. Bxe7 Qxe7 19. exd6 Qf6 20. Nbd2 Nxd6
+21. Nc4 Nxc4 22. Bxc4 Nb6 23. Ne5 Rae8 24. Bxf7+ Rxf7 25. Nxf7 Rxe1+ 1/2-1/2
+    )raw";
+    std::optional<Game> parsed = Game::fromPgn(pgn);
+    ASSERT_TRUE(parsed.has_value());
+
+    Game game {};
+    for (std::size_t i = 1; i <= parsed.value().movesSize(); i++) {
+        ASSERT_TRUE(game.makeMove(parsed.value().moveAt(i).value().move));
+    }
+    for (std::size_t i = 1; i <= parsed.value().movesSize(); i++) {
+        EXPECT_EQ(parsed.value().moveAt(i), game.moveAt(i)) << "at half move " << i;
+    }
+    EXPECT_TRUE(game.moveAt(10, Color::Black).value().isSrcFileAmbigious);
+    EXPECT_TRUE(game.moveAt(23, Color::Black).value().isSrcFileAmbigious);
+    // the game played here has no result yet
+    std::string moves_pgn = game.toPgn(false);
+    moves_pgn.pop_back();
+    EXPECT_EQ(parsed.value().toPgn(false), moves_pgn + " 1/2-1/2\n");
+}
+
 TEST_F(GameTestFixture, parsing_pgn_with_promotion_and_checkmate) {
     std::string const pgn = R"raw(
 [Event "Rated Blitz game"]
@@ -219,6 +247,15 @@ TEST_F(GameTestFixture, parsing_pgn_with_promotion_and_checkmate) {
 51. Qb4# 1-0
 )raw";
     ASSERT_EQ(expected_pgn, game.toPgn());
+
+    // the same moves played without validation end up with the same annotations and result
+    Game replayed {};
+    for (std::size_t i = 1; i <= game.movesSize(); i++) {
+        replayed.makeLegalMove(game.moveAt(i).value().move);
+    }
+    ASSERT_EQ(ResultType::WhiteWin, replayed.result().value());
+    ASSERT_EQ(game.board(), replayed.board());
+    ASSERT_EQ(game.toPgn(false), replayed.toPgn(false));
 }
 
 TEST_F(GameTestFixture, parsing_pgn_with_ambigious_rank) {
@@ -667,6 +704,109 @@ TEST_F(GameTestFixture, game_is_aware_of_threefold_repetition) {
     ASSERT_EQ(14, game.movesSize());
 }
 
+TEST_F(GameTestFixture, packed_move_with_context_round_trips) {
+    std::vector<Game::MoveWithContext> moves {
+        {Move({4,0}, {2,0}), white_king, false, true, false, false, false, Side::QueenSide},
+        {Move({4,7}, {6,7}), black_king, false, false, false, false, false, Side::KingSide},
+        {Move({3,6}, {2,7}, Piece::Type::Knight), white_pawn, true, false, true, true, false, std::nullopt},
+        {Move({1,7}, {3,6}), black_knight, false, false, false, true, true, std::nullopt},
+        {Move({0,0}, {0,3}), white_rook, true, true, false, false, true, std::nullopt},
+    };
+    for (Game::MoveWithContext const& mv: moves) {
+        EXPECT_EQ(mv, Game::PackedMoveWithContext(mv).toMoveWithContext()) << mv.move;
+    }
+}
+
+TEST_F(GameTestFixture, board_at_any_ply_and_undo) {
+    std::string const pgn = R"raw(
+1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6 8. c3 O-O 9. h3 Nb8 10. d4 Nbd7
+11. c4 c6 12. cxb5 axb5 13. Nc3 Bb7 14. Bg5 b4 15. Nb1 h6 16. Bh4 c5 17. dxe5 Nxe4 18. Bxe7 Qxe7
+)raw";
+    // an interval of 0 keeps a board after every ply like 1
+    for (std::size_t interval: {std::size_t {0}, std::size_t {1}, std::size_t {5}, Game::defaultCheckpointInterval, std::size_t {1000}}) {
+        Game game = Game::fromPgn(pgn, interval).value();
+        Board board = Board::startingPosBoard();
+        for (std::size_t ply = 0; ply <= game.movesSize(); ply++) {
+            ASSERT_EQ(board, game.boardAt(ply).value()) << "at ply " << ply << " with interval " << interval;
+            if (ply < game.movesSize()) {
+                board.forceMakeMove(game.moveAt(ply + 1).value().move);
+            }
+        }
+        ASSERT_EQ(game.board(), game.boardAt(game.movesSize()).value());
+        ASSERT_EQ(std::nullopt, game.boardAt(game.movesSize() + 1));
+
+        // taking moves back and playing them again leaves the game as it was
+        std::string full_pgn = game.toPgn(false);
+        std::vector<Move> taken_back;
+        while (game.movesSize() > 13) {
+            taken_back.push_back(game.moveAt(game.movesSize()).value().move);
+            ASSERT_TRUE(game.undo());
+            ASSERT_EQ(game.boardAt(game.movesSize()).value(), game.board());
+        }
+        ASSERT_EQ(Board::fromFen("r1bqk2r/2ppbppp/p1n2n2/1p2p3/4P3/1B3N2/PPPP1PPP/RNBQR1K1 b kq - 1 7").value(), game.board());
+        for (auto it = taken_back.rbegin(); it != taken_back.rend(); it++) {
+            ASSERT_TRUE(game.makeMove(*it));
+        }
+        ASSERT_EQ(full_pgn, game.toPgn(false));
+    }
+
+    Game every_ply {0};
+    ASSERT_TRUE(every_ply.makeMove(Move({4,1}, {4,3})));
+    ASSERT_EQ(Board::startingPosBoard(), every_ply.boardAt(0).value());
+    ASSERT_TRUE(every_ply.undo());
+    ASSERT_EQ(Board::startingPosBoard(), every_ply.board());
+
+    Game game {};
+    ASSERT_FALSE(game.undo());
+    // fools mate, and taking the mate back
+    ASSERT_TRUE(game.makeMove(Move({5,1}, {5,2})));
+    ASSERT_TRUE(game.makeMove(Move({4,6}, {4,4})));
+    ASSERT_TRUE(game.makeMove(Move({6,1}, {6,3})));
+    ASSERT_TRUE(game.makeMove(Move({3,7}, {7,3})));
+    ASSERT_EQ(ResultType::BlackWin, game.result().value());
+    ASSERT_TRUE(game.undo());
+    ASSERT_EQ(std::nullopt, game.result());
+    ASSERT_EQ(3, game.movesSize());
+    ASSERT_TRUE(game.makeMove(Move({1,7}, {2,5})));
+
+    // the roster of a parsed game forgets its result too
+    Game parsed = Game::fromPgn(R"raw([Event "Fools mate"]
+[Result "0-1"]
+
+1. f3 e5 2. g4 Qh4# 0-1
+)raw").value();
+    ASSERT_TRUE(parsed.undo());
+    ASSERT_EQ(std::nullopt, parsed.result());
+    ASSERT_EQ(std::nullopt, parsed.sevenTagRoster().result);
+    ASSERT_EQ(R"raw([Event "Fools mate"]
+[Site ""]
+[Date ""]
+[Round ""]
+[White ""]
+[Black ""]
+[Result "*"]
+
+1. f3 e5 2. g4
+)raw", parsed.toPgn());
+}
+
+TEST_F(GameTestFixture, game_sees_upcoming_repetition) {
+    Game game {};
+    ASSERT_FALSE(game.hasUpcomingRepetition());
+    game.makeLegalMove(Move({6,0}, {5,2}));
+    game.makeLegalMove(Move({6,7}, {5,5}));
+    ASSERT_FALSE(game.hasUpcomingRepetition());
+    // black can now play Ng8 back into the starting position
+    game.makeLegalMove(Move({5,2}, {6,0}));
+    ASSERT_TRUE(game.hasUpcomingRepetition());
+    // and after it does white can play Nf3 back into the position after 1. Nf3
+    game.makeLegalMove(Move({5,5}, {6,7}));
+    ASSERT_TRUE(game.hasUpcomingRepetition());
+    // a pawn move makes every earlier position unreachable
+    game.makeLegalMove(Move({4,1}, {4,3}));
+    ASSERT_FALSE(game.hasUpcomingRepetition());
+}
+
 TEST_F(GameTestFixture, game_is_aware_of_fifty_move_rule) {
     auto game_opt = Game::fromPgn(R"raw(
 [Event "Rated Bullet game"]
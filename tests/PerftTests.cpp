@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <glog/logging.h>
+
+#include "ChessEngineLib/Board.hpp"
+#include "ChessEngineLib/GameEngine.hpp"
+#include "ChessEngineLib/Perft.hpp"
+
+using namespace ChessEngineLib;
+
+class PerftTestFixture : public ::testing::Test {
+protected:
+    PerftTestFixture() {
+    }
+
+    ~PerftTestFixture() = default;
+
+    // reference positions and numbers from https://www.chessprogramming.org/Perft_Results
+    const std::string starting_position_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    const std::string kiwipete_fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    const std::string position_3_fen = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1";
+    const std::string position_4_fen = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1";
+    const std::string position_5_fen = "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8";
+    const std::string position_6_fen = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10";
+};
+
+TEST_F(PerftTestFixture, perft_node_counts_match_reference_positions) {
+    Board board = Board::fromFen(starting_position_fen).value();
+    EXPECT_EQ(1u, perft(board, 0));
+    EXPECT_EQ(20u, perft(board, 1));
+    EXPECT_EQ(400u, perft(board, 2));
+    EXPECT_EQ(8902u, perft(board, 3));
+    EXPECT_EQ(197281u, perft(board, 4));
+
+    EXPECT_EQ(48u, perft(Board::fromFen(kiwipete_fen).value(), 1));
+    EXPECT_EQ(2039u, perft(Board::fromFen(kiwipete_fen).value(), 2));
+    EXPECT_EQ(97862u, perft(Board::fromFen(kiwipete_fen).value(), 3));
+    EXPECT_EQ(43238u, perft(Board::fromFen(position_3_fen).value(), 4));
+    EXPECT_EQ(9467u, perft(Board::fromFen(position_4_fen).value(), 3));
+    EXPECT_EQ(422333u, perft(Board::fromFen(position_4_fen).value(), 4));
+    EXPECT_EQ(62379u, perft(Board::fromFen(position_5_fen).value(), 3));
+    EXPECT_EQ(89890u, perft(Board::fromFen(position_6_fen).value(), 3));
+}
+
+TEST_F(PerftTestFixture, detailed_perft_matches_reference_breakdown) {
+    PerftStats expected {197281, 1576, 0, 0, 0, 469, 8};
+    EXPECT_EQ(expected, perftDetailed(Board::fromFen(starting_position_fen).value(), 4));
+    expected = {97862, 17102, 45, 3162, 0, 993, 1};
+    EXPECT_EQ(expected, perftDetailed(Board::fromFen(kiwipete_fen).value(), 3));
+    expected = {43238, 3348, 123, 0, 0, 1680, 17};
+    EXPECT_EQ(expected, perftDetailed(Board::fromFen(position_3_fen).value(), 4));
+    expected = {9467, 1021, 4, 0, 120, 38, 22};
+    EXPECT_EQ(expected, perftDetailed(Board::fromFen(position_4_fen).value(), 3));
+}
+
+TEST_F(PerftTestFixture, perft_divide_sums_to_perft_and_leaves_board_unchanged) {
+    Board const board = Board::fromFen(kiwipete_fen).value();
+    Board const board_before = board;
+    auto divide = perftDivide(board, 3);
+    EXPECT_EQ(48u, divide.size());
+    std::uint64_t total = 0;
+    for (auto const& [move, nodes]: divide) {
+        EXPECT_TRUE(isMoveLegal(board, move)) << move;
+        total += nodes;
+    }
+    EXPECT_EQ(perft(board, 3), total);
+    EXPECT_EQ(board_before, board);
+    EXPECT_TRUE(perftDivide(board, 0).empty());
+}
+
+TEST_F(PerftTestFixture, parallel_perft_matches_single_threaded_counts) {
+    for (std::string const& fen: {starting_position_fen, kiwipete_fen, position_3_fen, position_4_fen, position_5_fen}) {
+        Board const board = Board::fromFen(fen).value();
+        auto expected = perftDivide(board, 3);
+        for (std::size_t threads: {1, 3}) {
+            EXPECT_EQ(expected, perftDivideParallel(board, 3, threads, 1 << 12)) << "for fen: " << fen << " and threads " << threads;
+            EXPECT_EQ(expected, perftDivideParallel(board, 3, threads, 0)) << "for fen: " << fen << " and threads " << threads;
+        }
+    }
+    // small table so that entries get overwritten while other threads read them
+    EXPECT_EQ(4085603u, perftParallel(Board::fromFen(kiwipete_fen).value(), 4, 4, 1 << 10));
+    EXPECT_EQ(1u, perftParallel(Board::fromFen(kiwipete_fen).value(), 0, 4));
+}